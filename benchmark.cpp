@@ -0,0 +1,149 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include "si5351.h"
+
+/*
+ * Benchmark sketch: runs typical tuning scenarios and reports one CSV line per scenario:
+ *
+ *   BENCH,<scenario>,<ops>,<ops_per_s>,<p50_us>,<p99_us>,<max_us>,<bytes>,<transactions>,<resets>
+ *
+ * Latency is measured per operation (setFreq + update, setPhase + update or enable)
+ * with the RP2040 1 MHz timer, bus cost comes from the driver's own counters.
+ *
+ * On RP2040 it also reports cold vs warm latency of the hot path in CPU cycles:
+ *
+ *   LATENCY,<function>,<cold_cycles>,<warm_cycles>
+ *
+ * Build once with and once without -DSI5351_RAM_HOTPATH to see the effect of SRAM placement.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/timer.h>
+#include <hardware/structs/systick.h>
+#include <hardware/structs/xip_ctrl.h>
+static inline uint32_t nowUs() { return time_us_32(); } // RP2040 1 MHz system timer
+#else
+static inline uint32_t nowUs() { return micros(); }
+#endif
+
+#define BENCH_OPS 500 // Operations per scenario
+
+Si5351 vfo(25000000UL); // Crystal is 25 MHz
+
+static uint32_t lat[BENCH_OPS]; // Latency of each operation in us
+static uint32_t rnd = 1;        // xorshift state, fixed seed for repeatable runs
+
+static uint32_t nextRandom() {
+    rnd ^= rnd << 13;
+    rnd ^= rnd >> 17;
+    rnd ^= rnd << 5;
+    return rnd;
+}
+
+static int cmpU32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Scenario operations, i is the operation number within the scenario
+static void opHop(uint16_t i)   { (void)i; vfo.setFreq(0, 3000000UL + nextRandom() % 27000000UL); vfo.update(0); }
+static void opStep(uint16_t i)  { vfo.setFreq(0, 7074000UL + 10UL * i); vfo.update(0); }
+static void opSweep(uint16_t i) { vfo.setFreq(0, 7000000UL + 1000UL * i); vfo.update(0); }
+static void opPhase(uint16_t i) { vfo.setPhase(0, i & 3); vfo.update(0); }
+static void opToggle(uint16_t i) { vfo.enable(1, i & 1); }
+
+static void runScenario(const char* name, void (*op)(uint16_t)) {
+    vfo.clearStats();
+    uint32_t t0 = nowUs();
+    for (uint16_t i = 0; i < BENCH_OPS; i++) {
+        uint32_t t = nowUs();
+        op(i);
+        lat[i] = nowUs() - t;
+    }
+    uint32_t total = nowUs() - t0;
+    const si_stats_t& s = vfo.stats();
+
+    qsort(lat, BENCH_OPS, sizeof(lat[0]), cmpU32);
+    Serial.print("BENCH,");
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print((unsigned long)BENCH_OPS);
+    Serial.print(',');
+    Serial.print(total ? (unsigned long)(1000000ULL * BENCH_OPS / total) : 0UL);
+    Serial.print(',');
+    Serial.print((unsigned long)lat[BENCH_OPS / 2]);
+    Serial.print(',');
+    Serial.print((unsigned long)lat[BENCH_OPS * 99 / 100]);
+    Serial.print(',');
+    Serial.print((unsigned long)lat[BENCH_OPS - 1]);
+    Serial.print(',');
+    Serial.print((unsigned long)s.bytes);
+    Serial.print(',');
+    Serial.print((unsigned long)s.transactions);
+    Serial.print(',');
+    Serial.println((unsigned long)s.resets);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+static volatile uint32_t sink; // Keeps the measured calls from being optimised away
+
+static void fnPlan()   { vfo_t v; Si5351::plan(25000000UL, 14074000UL, v); sink = v.msnb; }
+static void fnEncode() { uint8_t b[8]; Si5351::encodeMSN(b, 28, sink & 0xFFFF, SI_PLL_C); sink = b[7]; }
+static void fnUpdate() { vfo.setFreq(0, 7074000UL + (sink ^= 10)); vfo.update(0); }
+static void fnEnable() { vfo.enable(1, (sink ^= 1) & 1); }
+
+// Measure one call in CPU cycles, flushing the XIP cache first for a cold call so that code
+// left in flash pays for the cache misses while SRAM-resident code does not
+static uint32_t cycles(void (*fn)(), bool cold) {
+    if (cold) {
+        xip_ctrl_hw->flush = 1;   // Invalidate the XIP cache
+        (void)xip_ctrl_hw->flush; // Reading stalls until the flush is complete
+    }
+    systick_hw->cvr = 0;          // Restart the count down from the reload value
+    uint32_t t = systick_hw->cvr;
+    fn();
+    return (t - systick_hw->cvr) & 0x00FFFFFF; // 24-bit down counter
+}
+
+static void runLatency(const char* name, void (*fn)()) {
+    uint32_t cold = cycles(fn, true);
+    fn(); // Make sure everything is cached before the warm call
+    uint32_t warm = cycles(fn, false);
+    Serial.print("LATENCY,");
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print((unsigned long)cold);
+    Serial.print(',');
+    Serial.println((unsigned long)warm);
+}
+#endif
+
+void setup() {
+    Serial.begin(57600);
+    while (!Serial) {} // Wait for the USB serial port so no report line is lost
+
+    vfo.begin();
+    Serial.println("BENCH,scenario,ops,ops_per_s,p50_us,p99_us,max_us,bytes,transactions,resets");
+
+    runScenario("hop", opHop);       // Random hops between 3 and 30 MHz
+    runScenario("step", opStep);     // 10 Hz fine tuning steps
+    runScenario("sweep", opSweep);   // 1 kHz sweep steps
+    runScenario("phase", opPhase);   // Cycle through the four quadrature phases
+    runScenario("toggle", opToggle); // Toggle VFO1 output enable
+
+#if defined(ARDUINO_ARCH_RP2040)
+    systick_hw->rvr = 0x00FFFFFF; // Free running SysTick at the CPU clock
+    systick_hw->csr = 0x5;        // Enable, processor clock source, no interrupt
+    Serial.println("LATENCY,function,cold_cycles,warm_cycles");
+    runLatency("plan", fnPlan);
+    runLatency("encodeMSN", fnEncode);
+    runLatency("update", fnUpdate);
+    runLatency("enable", fnEnable);
+#endif
+
+    Serial.println("BENCH,done");
+}
+
+void loop() {
+    // Nothing to do, the report is printed once
+}
@@ -1,243 +1,1014 @@
-#include "si5351.h"
-
-/*
- * si5351.cpp
- *
- * Created: August 2025
- * Author: Anton W. Zimakos (aka UN8JAB)
- *
- * Driver for Si5351A chip.
- * VFO 0 quadrature for CLK0 and CLK1,
- * VFO 1 simple for CLK2.
- *
- * For more information see AN619
- */
-
-// ============ I2C Communication Functions ============
-
-// Write a single byte to a specified register on the SI5351
-void Si5351::_wr(uint8_t reg, uint8_t val) {
-    Wire.beginTransmission(SI5351_ADDR); // Start I2C communication with SI5351
-    Wire.write(reg);                   // Specify the target register
-    Wire.write(val);                   // Write the value to the register
-    Wire.endTransmission();            // End the I2C transmission
-}
-
-// Write multiple bytes to consecutive registers starting from a specified register
-void Si5351::_wrBulk(uint8_t reg, const uint8_t* data, uint8_t len) {
-    Wire.beginTransmission(SI5351_ADDR); // Start I2C communication with SI5351
-    Wire.write(reg);                   // Specify the starting register
-    for (uint8_t i = 0; i < len; i++) {
-        Wire.write(data[i]);           // Write each byte from the data array
-    }
-    Wire.endTransmission();            // End the I2C transmission
-}
-
-// Read a single byte from a specified register on the SI5351
-uint8_t Si5351::_rd(uint8_t reg) {
-    Wire.beginTransmission(SI5351_ADDR); // Start I2C communication with SI5351
-    Wire.write(reg);                   // Specify the register to read
-    Wire.endTransmission(false);       // End transmission but keep the connection active
-    Wire.requestFrom(SI5351_ADDR, (uint8_t)1); // Request one byte from the SI5351
-    return Wire.available() ? Wire.read() : 0xFF; // Return the read byte or 0xFF if no data
-}
-
-// Convert an R divider value (1, 2, 4, 8, 16, 32, 64, 128) to its corresponding code
-uint8_t Si5351::_rDivToCode(uint8_t r) {
-    switch (r) {
-        case 1:   return 0; // R=1 maps to code 0
-        case 2:   return 1; // R=2 maps to code 1
-        case 4:   return 2; // R=4 maps to code 2
-        case 8:   return 3; // R=8 maps to code 3
-        case 16:  return 4; // R=16 maps to code 4
-        case 32:  return 5; // R=32 maps to code 5
-        case 64:  return 6; // R=64 maps to code 6
-        case 128: return 7; // R=128 maps to code 7
-        default:  return 0; // Default to code 0 (R=1) for invalid inputs
-    }
-}
-
-// ============ Public API Functions ============
-
-// Initialize the SI5351 chip and configure initial settings
-void Si5351::begin() {
-    Wire.begin(); // Initialize I2C communication
-
-    // Disable spread spectrum to ensure stable output frequencies (AN619 p.8-9)
-    _wr(SI_SS_EN, 0x00);
-
-    // Configure output clocks: CLK0 and CLK1 use PLLA, CLK2 uses PLLB, 4mA drive strength
-    _wr(SI_CLK0_CTL, (uint8_t)(SI_CLK_SRC_MS | SI_CLK_IDRV_4mA)); // CLK0: MultiSynth source, 4mA
-    _wr(SI_CLK1_CTL, (uint8_t)(SI_CLK_SRC_MS | SI_CLK_IDRV_4mA)); // CLK1: MultiSynth source, 4mA
-    _wr(SI_CLK2_CTL, (uint8_t)(SI_CLK_SRC_MS | SI_CLK_PLLB | SI_CLK_IDRV_4mA)); // CLK2: MultiSynth, PLLB, 4mA
-
-    // Set initial VFO configurations (frequency, phase, divider, multiplier, etc.)
-    _vfo[0] = {7074000UL, PH270, 1, 106, 30.0}; // VFO0: 7.074 MHz, 270° phase
-    _vfo[1] = {10000000UL, PH000, 1, 76, 30.0}; // VFO1: 10 MHz, 0° phase
-
-    // Apply initial settings to VFO0 and VFO1
-    update(0);
-    update(1);
-
-    // Enable VFO0 (CLK0 and CLK1) and disable VFO1 (CLK2) by default
-    enable(0, true);
-    enable(1, false);
-}
-
-// Reset both PLLA and PLLB to apply new settings
-void Si5351::resetPLL() {
-    _wr(SI_PLL_RESET, 0xA0); // Reset PLLA and PLLB (may cause a brief click)
-}
-
-// Enable or disable a specific VFO output
-void Si5351::enable(uint8_t vfoIdx, bool en) {
-    uint8_t oe = _rd(SI_CLK_OE); // Read current output enable register
-    if (vfoIdx == 0) {
-        // VFO0 controls CLK0 and CLK1
-        if (en) oe &= ~0x03; // Enable CLK0 and CLK1
-        else oe |= 0x03;     // Disable CLK0 and CLK1
-    } else {
-        // VFO1 controls CLK2
-        if (en) oe &= ~0x04; // Enable CLK2
-        else oe |= 0x04;     // Disable CLK2
-    }
-    _wr(SI_CLK_OE, oe); // Write updated output enable settings
-}
-
-// Set the phase for VFO0 (CLK0 and CLK1)
-void Si5351::setPhase(uint8_t vfoIdx, uint8_t phase) {
-    if (vfoIdx != 0 || phase > 3) return; // Only VFO0 supports phase, valid values 0-3
-    _vfo[0].phase = phase; // Store the phase setting (0°, 90°, 180°, or 270°)
-}
-
-// Set the frequency for a specific VFO
-void Si5351::setFreq(uint8_t vfoIdx, uint32_t freqHz) {
-    if (vfoIdx > 1) return; // Only VFO0 and VFO1 are supported
-    _evaluate(vfoIdx, freqHz); // Calculate and store new frequency parameters
-}
-
-// Update the SI5351 registers for a specific VFO
-void Si5351::update(uint8_t vfoIdx) {
-    if (vfoIdx > 1) return; // Only VFO0 and VFO1 are supported
-
-    // Configure PLL multiplier (MSN) for the selected VFO
-    _setMSN(vfoIdx == 0 ? 0 : 1, _vfo[vfoIdx].msn);
-
-    if (vfoIdx == 0) {
-        // VFO0 controls CLK0 and CLK1 with the same MultiSynth divider in integer mode
-        uint8_t rcode = _rDivToCode(_vfo[0].ri); // Get R divider code
-        _setMSI(0, _vfo[0].msi, rcode); // Configure CLK0 MultiSynth
-        _setMSI(1, _vfo[0].msi, rcode); // Configure CLK1 MultiSynth
-
-        // Set phase offset for quadrature output (90° shift if needed)
-        _wr(SI_CLK0_PHOFF, 0); // Reset CLK0 phase offset
-        _wr(SI_CLK1_PHOFF, (_vfo[0].phase == PH090 || _vfo[0].phase == PH270) ? _vfo[0].msi : 0); // Set CLK1 phase
-
-        // Configure clock control registers, including inversion for 180°/270° phase
-        uint8_t clk0ctl = (uint8_t)(SI_CLK_SRC_MS | SI_CLK_INT | SI_CLK_IDRV_4mA); // CLK0: MultiSynth, integer mode, 4mA
-        uint8_t clk1ctl = (uint8_t)(SI_CLK_SRC_MS | SI_CLK_INT | SI_CLK_IDRV_4mA); // CLK1: MultiSynth, integer mode, 4mA
-        if (_vfo[0].phase == PH180 || _vfo[0].phase == PH270) clk1ctl |= SI_CLK_INV; // Invert CLK1 for 180°/270°
-        _wr(SI_CLK0_CTL, clk0ctl); // Apply CLK0 settings
-        _wr(SI_CLK1_CTL, clk1ctl); // Apply CLK1 settings
-    } else {
-        // VFO1 controls CLK2
-        uint8_t rcode = _rDivToCode(_vfo[1].ri); // Get R divider code
-        _setMSI(2, _vfo[1].msi, rcode); // Configure CLK2 MultiSynth
-
-        // Configure CLK2 to use PLLB in integer mode
-        uint8_t clk2ctl = (uint8_t)(SI_CLK_SRC_MS | SI_CLK_INT | SI_CLK_PLLB | SI_CLK_IDRV_4mA);
-        _wr(SI_CLK2_CTL, clk2ctl); // Apply CLK2 settings
-    }
-
-    // Reset PLLs to apply the new settings
-    resetPLL();
-}
-
-// ============ Internal Configuration Functions ============
-
-// Configure PLL multiplier (MSN = a + b/c) for a specified PLL (0 for PLLA, 1 for PLLB)
-void Si5351::_setMSN(uint8_t pllIdx, double msn) {
-    uint32_t A = (uint32_t)floor(msn); // Integer part of the multiplier
-    uint32_t B = (uint32_t)((msn - (double)A) * (double)SI_PLL_C); // Fractional part numerator
-    uint32_t P1, P2, P3 = SI_PLL_C; // Denominator for fractional part
-
-    // Calculate P1 and P2 based on the SI5351 application note (AN619)
-    uint32_t tmp = (uint32_t)floor((double)(128 * B) / (double)SI_PLL_C);
-    P1 = (uint32_t)(128 * A + tmp - 512);
-    P2 = (uint32_t)(128 * B - SI_PLL_C * tmp);
-
-    // Prepare register data for PLL configuration
-    uint8_t base = (pllIdx == 0) ? SI_SYNTH_PLLA : SI_SYNTH_PLLB; // Select PLLA or PLLB base register
-    uint8_t buf[8];
-    buf[0] = (P3 >> 8) & 0xFF; // P3[15:8]
-    buf[1] = P3 & 0xFF;        // P3[7:0]
-    buf[2] = (P1 >> 16) & 0x03; // P1[17:16]
-    buf[3] = (P1 >> 8) & 0xFF; // P1[15:8]
-    buf[4] = P1 & 0xFF;        // P1[7:0]
-    buf[5] = ((P3 >> 12) & 0xF0) | ((P2 >> 16) & 0x0F); // P3[19:16] | P2[19:16]
-    buf[6] = (P2 >> 8) & 0xFF; // P2[15:8]
-    buf[7] = P2 & 0xFF;        // P2[7:0]
-
-    _wrBulk(base, buf, 8); // Write the PLL configuration to registers
-}
-
-// Configure MultiSynth divider for a specific clock output in integer mode
-void Si5351::_setMSI(uint8_t clkIdx, uint8_t msiEven, uint8_t rDivLog2) {
-    uint32_t P1 = 128UL * (uint32_t)msiEven - 512UL; // Calculate P1 for integer mode
-    uint8_t base = (clkIdx == 0) ? SI_SYNTH_MS0 : (clkIdx == 1 ? SI_SYNTH_MS1 : SI_SYNTH_MS2); // Select MultiSynth base register
-    uint8_t Rbits = (rDivLog2 & 0x07) << 4; // Shift R divider code to correct bit position
-
-    // Prepare register data for MultiSynth configuration
-    uint8_t buf[8];
-    buf[0] = 0x00; // P3[15:8] = 0 (P3=1 in integer mode)
-    buf[1] = 0x01; // P3[7:0] = 1
-    buf[2] = (uint8_t)((P1 >> 16) & 0x03) | Rbits; // P1[17:16] | R divider bits
-    buf[3] = (uint8_t)((P1 >> 8) & 0xFF); // P1[15:8]
-    buf[4] = (uint8_t)(P1 & 0xFF);       // P1[7:0]
-    buf[5] = 0x00; // P3[19:16]=0, P2[19:16]=0 (P3=1, P2=0)
-    buf[6] = 0x00; // P2[15:8]=0
-    buf[7] = 0x00; // P2[7:0]=0
-
-    _wrBulk(base, buf, 8); // Write the MultiSynth configuration to registers
-}
-
-// Calculate optimal parameters for a desired output frequency
-void Si5351::_evaluate(uint8_t vfoIdx, uint32_t freqHz) {
-    if (vfoIdx > 1 || _vfo[vfoIdx].freq == freqHz) return; // Skip if invalid VFO or frequency unchanged
-
-    // Strategy: Target VCO frequency around 700 MHz, use even integer MultiSynth divider (4-126),
-    // and select R divider based on frequency range
-    uint32_t ri; // R divider
-    if (freqHz < 1000000UL) ri = 128; // Use R=128 for frequencies below 1 MHz
-    else if (freqHz < 3000000UL) ri = 32; // Use R=32 for 1-3 MHz
-    else ri = 1; // Use R=1 for frequencies above 3 MHz
-
-    uint8_t msi; // MultiSynth integer divider
-    if (freqHz < 6000000UL) {
-        msi = 126; // Use maximum divider for low frequencies
-    } else {
-        // Calculate divider to target ~700 MHz VCO frequency
-        uint32_t tentative = (uint32_t)(700000000UL / ((uint64_t)freqHz * ri));
-        if (tentative < 4) tentative = 4; // Ensure divider is at least 4
-        if (tentative > 126) tentative = 126; // Cap at 126
-        if (tentative & 1) tentative++; // Make even if odd
-        if (tentative > 126) tentative = 126; // Ensure cap after increment
-        msi = (uint8_t)tentative;
-    }
-
-    // Verify if the calculated VCO frequency is within valid range
-    uint64_t fvco = (uint64_t)freqHz * (uint64_t)msi * (uint64_t)ri;
-    if (fvco < SI_VCO_LO || fvco > SI_VCO_HI) {
-        // If out of range, parameters are still valid as they will be applied correctly
-    }
-
-    // Calculate PLL multiplier (MSN) based on crystal frequency
-    double msn = ((double)msi * (double)ri * (double)freqHz) / (double)_xtal;
-
-    // Store calculated parameters in VFO structure
-    _vfo[vfoIdx].freq = freqHz;
-    _vfo[vfoIdx].ri = (uint8_t)ri;
-    _vfo[vfoIdx].msi = msi;
-    _vfo[vfoIdx].msn = msn;
-
-}
+#include "si5351.h"
+
+#ifdef SI5351_MINIMAL
+#define SI_COUNT(field, n) // Bus traffic counters are compiled out
+#else
+#define SI_COUNT(field, n) (_stats.field += (n))
+#endif
+
+// What the last update() of a VFO still owes (_lockWait[].what), settled by pollLock()
+#define SI_WAIT_LOCK    0x01 // PLL reset or band change: lock to be read from the status register
+#define SI_WAIT_BAND    0x02 // Band hook to call with SI_BAND_LOCKED or SI_BAND_NOLOCK
+#define SI_WAIT_EVENT   0x04 // LO event to push
+
+/*
+ * si5351.cpp
+ *
+ * Created: August 2025
+ * Author: Anton W. Zimakos (aka UN8JAB)
+ *
+ * Driver for Si5351A chip.
+ * VFO 0 quadrature for CLK0 and CLK1,
+ * VFO 1 simple for CLK2.
+ *
+ * For more information see AN619
+ */
+
+// ============ I2C Communication Functions ============
+
+// Write a single byte to a specified register on the SI5351
+SI5351_HOT bool Si5351::_wr(uint8_t reg, uint8_t val) {
+    return _wrBulk(reg, &val, 1);
+}
+
+// Write multiple bytes to consecutive registers starting from a specified register, split into
+// transactions the bus can take (maxWrite()). The mirror only follows writes the bus completed,
+// so it never claims a value the chip did not get.
+SI5351_HOT bool Si5351::_wrBulk(uint8_t reg, const uint8_t* data, uint8_t len) {
+    uint16_t max = _bus->maxWrite();
+    uint8_t step = max > 256 ? 255 : (max > 1 ? max - 1 : 1); // Data bytes after the register address
+    while (len) {
+        uint8_t n = len < step ? len : step;
+        if (!_bus->write(SI5351_ADDR, &reg, 1, data, n)) { // Starting register, then the data
+            SI_COUNT(errors, 1);
+            return false;
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            uint8_t r = reg + i;
+            _reg[r] = _next[r] = data[i]; // Mirror the registers
+            _known[r >> 3] |= 1 << (r & 7);
+        }
+        SI_COUNT(transactions, 1);
+        SI_COUNT(bytes, n + 1);
+        reg += n;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Read a single byte from a specified register on the SI5351
+SI5351_HOT uint8_t Si5351::_rd(uint8_t reg) {
+    uint8_t val;
+    SI_COUNT(reads, 1);
+    return _bus->read(SI5351_ADDR, &reg, 1, &val, 1) ? val : 0xFF; // The read byte or 0xFF if no data
+}
+
+// ============ Bus Rate Probing ============
+
+// Patterns vary per round and byte, so stuck, swapped or shifted bits all show up
+bool Si5351::_probe(uint32_t hz) {
+    _bus->setClock(hz);
+    uint8_t reg = SI_SCRATCH;
+    for (uint8_t n = 0; n < SI_PROBE_ROUNDS; n++) {
+        uint8_t pat[SI_SCRATCH_LEN], back[SI_SCRATCH_LEN];
+        for (uint8_t i = 0; i < SI_SCRATCH_LEN; i++) pat[i] = (uint8_t)(((i & 1) ? 0xAA : 0x55) ^ (n * 0x3B + i));
+        SI_COUNT(transactions, 1);
+        SI_COUNT(bytes, SI_SCRATCH_LEN + 1);
+        SI_COUNT(reads, 1);
+        if (!_bus->write(SI5351_ADDR, &reg, 1, pat, SI_SCRATCH_LEN)) return false;
+        if (!_bus->read(SI5351_ADDR, &reg, 1, back, SI_SCRATCH_LEN)) return false;
+        if (memcmp(pat, back, SI_SCRATCH_LEN) != 0) return false;
+    }
+    return true;
+}
+
+// Each rate is checked 25% above itself, so the rate kept has that much margin. A failure ends
+// the probe, faster rates are not tried.
+uint32_t Si5351::probeBus(uint32_t maxHz) {
+    static const uint32_t rates[] = {100000UL, 400000UL, 1000000UL, 2000000UL, 3400000UL};
+    uint8_t reg = SI_SCRATCH;
+    uint8_t save[SI_SCRATCH_LEN];
+
+    _bus->setClock(rates[0]);
+    SI_COUNT(reads, 1);
+    if (!_bus->read(SI5351_ADDR, &reg, 1, save, SI_SCRATCH_LEN)) {
+        _busHz = 0; // No answer, nothing to probe
+        return 0;
+    }
+    _wr(SI_SS_EN, 0x00); // Spread spectrum off, so the scratch registers do nothing
+
+    uint32_t best = rates[0];
+    for (uint8_t i = 1; i < sizeof(rates) / sizeof(rates[0]) && rates[i] <= maxHz; i++) {
+        if (!_probe(rates[i] + rates[i] / 4)) break;
+        best = rates[i];
+    }
+    _bus->setClock(best);
+    _wrBulk(SI_SCRATCH, save, SI_SCRATCH_LEN);
+    _busHz = best;
+    return best;
+}
+
+// ============ Staged Register Image ============
+
+// Stage values for consecutive registers, nothing is sent until _commit()
+SI5351_HOT void Si5351::_stage(uint8_t reg, const uint8_t* data, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t r = reg + i;
+        _next[r] = data[i];
+        _dirty[r >> 3] |= 1 << (r & 7);
+    }
+}
+
+// A staged register must be sent if the chip has never seen it or holds another value
+SI5351_HOT bool Si5351::_differs(uint8_t reg) const {
+    if (!(_dirty[reg >> 3] & (1 << (reg & 7)))) return false; // Not staged
+    if (!(_known[reg >> 3] & (1 << (reg & 7)))) return true;  // Never written
+    return _next[reg] != _reg[reg];
+}
+
+// Check whether any register in a range still has to be sent
+SI5351_HOT bool Si5351::_pending(uint8_t reg, uint8_t len) const {
+    for (uint8_t i = 0; i < len; i++) {
+        if (_differs(reg + i)) return true;
+    }
+    return false;
+}
+
+// Send all changed staged registers, merging runs separated by small gaps of known registers.
+// Registers of a failed write stay staged, so the next commit sends them again.
+SI5351_HOT bool Si5351::_commit() {
+    int16_t start = -1; // First register of the current run
+    int16_t last = -1;  // Last changed register of the current run
+    bool ok = true;
+    for (int16_t r = 0; r < SI_REG_COUNT; r++) {
+        if (!_differs(r)) continue;
+        if (start >= 0) {
+            bool merge = (r - last - 1) <= SI_MERGE_GAP; // Gap registers are rewritten with their own value
+            for (int16_t g = last + 1; merge && g < r; g++) {
+                merge = _known[g >> 3] & (1 << (g & 7));
+            }
+            if (!merge) {
+                ok &= _wrBulk(start, &_next[start], last - start + 1);
+                start = r;
+            }
+        } else {
+            start = r;
+        }
+        last = r;
+    }
+    if (start >= 0) ok &= _wrBulk(start, &_next[start], last - start + 1);
+    if (ok) {
+        memset(_dirty, 0, sizeof(_dirty)); // Everything staged is now on the chip
+        return true;
+    }
+    for (int16_t r = 0; r < SI_REG_COUNT; r++) {
+        if (!_differs(r)) _dirty[r >> 3] &= ~(1 << (r & 7)); // Sent, or never needed sending
+    }
+    return false;
+}
+
+// Issue a PLL reset for the PLLs in the mask
+SI5351_HOT bool Si5351::_resetPLL(uint8_t mask) {
+    if (!_wr(SI_PLL_RESET, mask)) return false; // May cause a brief click
+    SI_COUNT(resets, 1);
+    return true;
+}
+
+// Saved settings must be something plan() could have produced
+bool Si5351::_valid(const vfo_t& v) {
+    if (v.freq == 0 || v.phase > PH270) return false;
+    if (v.ri == 0 || (v.ri & (v.ri - 1))) return false;                 // R is a power of two
+    if (v.msi < 4 || v.msi > 126 || (v.msi & 1)) return false;          // Even integer divider
+    if (v.msna < SI_MSN_MIN || v.msna > SI_MSN_MAX || v.msnb >= SI_PLL_C) return false;
+    return true;
+}
+
+// Convert an R divider value (1, 2, 4, 8, 16, 32, 64, 128) to its corresponding code
+SI5351_HOT uint8_t Si5351::_rDivToCode(uint8_t r) {
+    switch (r) {
+        case 1:   return 0; // R=1 maps to code 0
+        case 2:   return 1; // R=2 maps to code 1
+        case 4:   return 2; // R=4 maps to code 2
+        case 8:   return 3; // R=8 maps to code 3
+        case 16:  return 4; // R=16 maps to code 4
+        case 32:  return 5; // R=32 maps to code 5
+        case 64:  return 6; // R=64 maps to code 6
+        case 128: return 7; // R=128 maps to code 7
+        default:  return 0; // Default to code 0 (R=1) for invalid inputs
+    }
+}
+
+// ============ Public API Functions ============
+
+// Initialize the SI5351 chip and configure initial settings
+bool Si5351::begin() {
+    return begin(nullptr);
+}
+
+// Initialize from saved VFO states, or from the defaults where init is null or invalid
+bool Si5351::begin(const vfo_t* init) {
+    _bus->begin(); // Initialize I2C communication
+    if (_probeHz) probeBus(_probeHz);
+
+    // Keep all outputs disabled while the dividers are programmed
+    _stage(SI_CLK_OE, 0xFF);
+
+    // Disable spread spectrum to ensure stable output frequencies (AN619 p.8-9)
+    _stage(SI_SS_EN, 0x00);
+
+    // Set initial VFO configurations: saved states are used as they are, the defaults are
+    // planned from the actual crystal frequency
+    static const uint32_t defFreq[2] = {7074000UL, 10000000UL}; // VFO0: 7.074 MHz, VFO1: 10 MHz
+    static const uint8_t defPhase[2] = {PH270, PH000};          // VFO0: 270°, VFO1: 0°
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        if (init && _valid(init[i]) && !isFractional(i)) {
+            _vfo[i] = init[i];
+            continue;
+        }
+        _vfo[i] = vfo_t();
+        _vfo[i].phase = defPhase[i];
+        _evaluate(i, defFreq[i]);
+    }
+
+    // Stage VFO0 (CLK0/CLK1 on PLLA) and VFO1 (CLK2 on PLLB), then send it all with a single reset
+    _stageVfo(0);
+#if SI5351_VFO_COUNT > 1
+    _stageVfo(1);
+#else
+    _stage(SI_CLK2_CTL, _ctl(2)); // CLK2 is not used, keep it powered down
+#endif
+    if (!_commit() || !_resetPLL(SI_PLL_RESET_A | SI_PLL_RESET_B)) {
+        _resetDue = SI_PLL_RESET_A | SI_PLL_RESET_B; // Owed to the next update(), outputs stay off
+        return false;
+    }
+
+    // Enable VFO0 (CLK0 and CLK1), VFO1 (CLK2) stays disabled by default
+    return enable(0, true);
+}
+
+// Change the crystal frequency and re-plan every VFO for it (call update() to apply)
+void Si5351::setXtal(uint32_t xtalHz) {
+    _xtal = xtalHz;
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        uint32_t f = _vfo[i].freq;
+        _vfo[i].freq = 0; // Force planning even though the target is unchanged
+        if (!_evaluate(i, f)) _vfo[i].freq = f; // Unreachable now, keep the old dividers
+    }
+}
+
+// Reset both PLLA and PLLB to apply new settings
+void Si5351::resetPLL() {
+    _resetPLL(SI_PLL_RESET_A | SI_PLL_RESET_B); // Reset PLLA and PLLB (may cause a brief click)
+}
+
+// Write pre-encoded registers straight to the chip
+SI5351_HOT bool Si5351::writeRegs(uint8_t reg, const uint8_t* data, uint8_t len) {
+    if (!len || reg + len > SI_REG_COUNT) return false; // The mirror only covers the register map
+    if (!_wrBulk(reg, data, len)) return false;
+    if (reg == SI_PLL_RESET) { SI_COUNT(resets, 1); } // A reset sent as a register image still counts
+    return true;
+}
+
+// Mirror registers written by someone else
+void Si5351::noteRegs(uint8_t reg, const uint8_t* data, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t r = reg + i;
+        if (r >= SI_REG_COUNT) break;
+        _reg[r] = _next[r] = data[i];
+        _known[r >> 3] |= 1 << (r & 7);
+    }
+    SI_COUNT(transactions, 1);
+    SI_COUNT(bytes, len + 1);
+    if (reg == SI_PLL_RESET) { SI_COUNT(resets, 1); }
+}
+
+// Planned settings are applied by the next update()
+bool Si5351::setVfo(uint8_t vfoIdx, const vfo_t& v) {
+    if (vfoIdx >= SI5351_VFO_COUNT || !_valid(v) || isFractional(vfoIdx)) return false; // Integer dividers only
+    _vfo[vfoIdx] = v;
+    return true;
+}
+
+// Adopt VFO settings whose registers were written by someone else
+void Si5351::forgetRegs(uint8_t reg, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t r = reg + i;
+        if (r >= SI_REG_COUNT) break;
+        _known[r >> 3] &= ~(1 << (r & 7));
+    }
+}
+
+void Si5351::noteVfo(uint8_t vfoIdx, const vfo_t& v) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return;
+    _vfo[vfoIdx] = v;
+    if (vfoIdx == 1) _fracVco = 0; // The chip has integer dividers now
+}
+
+// Enable or disable a specific VFO output
+SI5351_HOT bool Si5351::enable(uint8_t vfoIdx, bool en) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return false; // VFO not compiled in
+
+    // With power save, a powered-down VFO is powered up and its PLL reset before the outputs
+    // come on, so they start aligned; on disable the outputs go off before the power-down
+    bool ok = true;
+    if (en && _powerSave && !isEnabled(vfoIdx)) {
+        _stageCtl(vfoIdx, true);
+        ok = _commit() && _resetPLL((_src[vfoIdx == 0 ? 0 : 2] & SI_CLK_PLLB) ? SI_PLL_RESET_B : SI_PLL_RESET_A);
+    }
+
+    uint8_t oe = _next[SI_CLK_OE]; // Output enable register as last set by the driver
+    if (vfoIdx == 0) {
+        // VFO0 controls CLK0 and CLK1
+        if (en) oe &= ~0x03; // Enable CLK0 and CLK1
+        else oe |= 0x03;     // Disable CLK0 and CLK1
+    } else {
+        // VFO1 controls CLK2
+        if (en) oe &= ~0x04; // Enable CLK2
+        else oe |= 0x04;     // Disable CLK2
+    }
+    _stage(SI_CLK_OE, oe); // Write updated output enable settings if they changed
+    if (!en && _powerSave) _stageCtl(vfoIdx); // Power down, after the OE write in the same commit
+    return _commit() && ok;
+}
+
+void Si5351::setDrive(uint8_t clkIdx, uint8_t drive) {
+    if (clkIdx > 2) return;
+    _drive[clkIdx] = drive & SI_CLK_IDRV;
+    if (clkIdx < 2) _stageCtl(0);
+#if SI5351_VFO_COUNT > 1
+    else _stageCtl(1);
+#endif
+    _commit();
+}
+
+// The table is applied on the next update(), when the VFO frequency is known
+void Si5351::setDriveTable(uint8_t vfoIdx, const si_drive_band_t* table, uint8_t n) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return;
+    _driveTable[vfoIdx] = n ? table : nullptr;
+    _driveBands[vfoIdx] = table ? n : 0;
+}
+
+// Tables and modes are used from the next setFreq(); the current dividers stay until then
+void Si5351::setVcoTable(uint8_t vfoIdx, const si_vco_band_t* table, uint8_t n) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return;
+    _vcoTable[vfoIdx] = n ? table : nullptr;
+    _vcoBands[vfoIdx] = table ? n : 0;
+}
+
+void Si5351::setVcoMode(uint8_t vfoIdx, uint8_t mode) {
+    if (vfoIdx >= SI5351_VFO_COUNT || mode > SI_VCO_SPAN) return;
+    _vcoMode[vfoIdx] = mode;
+}
+
+void Si5351::setVcoAvoid(const si_vco_zone_t* zones, uint8_t n) {
+    _vcoZones = n ? zones : nullptr;
+    _vcoZoneCount = zones ? n : 0;
+}
+
+// The VCO window divided by the current R and MultiSynth dividers
+bool Si5351::span(uint8_t vfoIdx, uint32_t& loHz, uint32_t& hiHz) const {
+    if (vfoIdx >= SI5351_VFO_COUNT || isFractional(vfoIdx)) return false;
+    const vfo_t& v = _vfo[vfoIdx];
+    uint64_t vcoLo, vcoHi;
+    if (!v.freq || !v.msi || !v.ri || !vcoWindow(_xtal, vcoLo, vcoHi)) return false;
+    uint32_t div = (uint32_t)v.ri * v.msi;
+    loHz = (uint32_t)((vcoLo + div - 1) / div);
+    hiHz = (uint32_t)(vcoHi / div);
+    return true;
+}
+
+void Si5351::setPowerSave(bool on) {
+    _powerSave = on;
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        if (!isEnabled(i)) _stageCtl(i); // Enabled VFOs are never powered down
+    }
+    _commit();
+}
+
+// Output state of a VFO as last set by the driver
+bool Si5351::isEnabled(uint8_t vfoIdx) const {
+    if (vfoIdx >= SI5351_VFO_COUNT) return false;
+    return !(_next[SI_CLK_OE] & (vfoIdx == 0 ? 0x03 : 0x04)); // Bit set = output disabled
+}
+
+// Two bits per clock: VFO0 = CLK0 [1:0] and CLK1 [3:2], VFO1 = CLK2 [5:4]
+void Si5351::setDisableState(uint8_t vfoIdx, uint8_t state) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return;
+    state &= 0x03;
+    uint8_t dis = _next[SI_CLK_DIS];
+    if (vfoIdx == 0) dis = (dis & ~0x0F) | state | (state << 2);
+    else dis = (dis & ~0x30) | (state << 4);
+    _stage(SI_CLK_DIS, dis);
+    _commit();
+}
+
+// Set the phase for VFO0 (CLK0 and CLK1)
+void Si5351::setPhase(uint8_t vfoIdx, uint8_t phase) {
+    if (vfoIdx != 0 || phase > 3) return; // Only VFO0 supports phase, valid values 0-3
+    _vfo[0].phase = phase; // Store the phase setting (0°, 90°, 180°, or 270°)
+}
+
+// Set the frequency for a specific VFO
+SI5351_HOT bool Si5351::setFreq(uint8_t vfoIdx, uint32_t freqHz) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return false; // Only VFO0 and VFO1 are supported
+    return _evaluate(vfoIdx, freqHz); // Calculate and store new frequency parameters
+}
+
+// Decode the planned dividers back into the produced frequency: xtal * (a + b/c) / (msi * R)
+uint32_t Si5351::getFreq(uint8_t vfoIdx) const {
+    if (vfoIdx >= SI5351_VFO_COUNT) return 0; // Unknown VFO
+    const vfo_t& v = _vfo[vfoIdx];
+    if (isFractional(vfoIdx)) { // xtal * (a + b/c) / ((ma + mb/mc) * R), VCO in mHz to stay within 64 bits
+        if (!v.freq) return 0;
+        uint64_t vcoMilli = (uint64_t)_xtal * ((uint64_t)v.msna * SI_PLL_C + v.msnb) / (SI_PLL_C / 1000);
+        uint64_t den = ((uint64_t)_ms2.a * _ms2.c + _ms2.b) * v.ri;
+        return (uint32_t)((vcoMilli * _ms2.c / den + 500) / 1000);
+    }
+    if (v.msi == 0) return 0; // Nothing planned yet
+    uint64_t num = (uint64_t)_xtal * ((uint64_t)v.msna * SI_PLL_C + v.msnb); // xtal * (a*c + b)
+    uint64_t den = (uint64_t)SI_PLL_C * v.msi * v.ri;                       // c * msi * R
+    return (uint32_t)((num + den / 2) / den); // Round to the nearest Hz
+}
+
+// Update the SI5351 registers for a specific VFO
+SI5351_HOT bool Si5351::update(uint8_t vfoIdx) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return false; // Only VFO0 and VFO1 are supported
+
+    // A band change is announced before anything is written, so the hook can mute or detach
+    uint8_t from = (_bandKnown & (1 << vfoIdx)) ? _band[vfoIdx] : SI_BAND_UNKNOWN;
+    uint8_t to = _bandCount ? band(_vfo[vfoIdx].freq) : 0;
+    bool cross = _bandHook && _bandCount && to != from;
+    if (cross) {
+        _lockCheck(vfoIdx, true); // The previous band change ends before this one starts
+        _bandHook(_bandCtx, vfoIdx, from, to, SI_BAND_BEFORE);
+    }
+
+    uint8_t reset = _stageVfo(vfoIdx) | _resetDue; // Stage registers and find out if a reset is needed
+    bool wrote = _events && _pending(0, SI_REG_COUNT);
+    if (wrote || reset) _lockCheck(vfoIdx, true); // Events stay in update order
+    bool sent = _commit(); // Send only the bytes that changed
+    uint32_t tWritten = (_events || cross) ? micros() : 0;
+    if (sent && reset) sent = _resetPLL(reset); // Reset the PLL to apply a new divider or phase
+    if (!sent) {
+        // Keep the reset for the retry: dividers that did arrive would otherwise never be applied
+        _resetDue = reset;
+        if (cross) _bandHook(_bandCtx, vfoIdx, from, to, SI_BAND_NOLOCK); // The band is not reached
+        return false;
+    }
+    _resetDue = 0;
+    uint32_t tReset = ((_events || cross) && reset) ? micros() : tWritten;
+
+    // Relays and filters switch while the PLL relocks instead of after it
+    if (cross) _bandHook(_bandCtx, vfoIdx, from, to, SI_BAND_RELOCK);
+
+    if (_events && (wrote || reset)) {
+        si_lo_event_t& e = _lockWait[vfoIdx].e;
+        e.freq = getFreq(vfoIdx);
+        e.written = tWritten;
+        e.reset = tReset;
+        e.locked = tWritten;
+        e.vfo = vfoIdx;
+        e.flags = reset ? SI_LO_RESET : 0;
+    }
+    // Lock after a reset or band change is confirmed by pollLock(), never waited for here
+    _lockWait[vfoIdx].start = tReset;
+    _lockWait[vfoIdx].from = from;
+    _lockWait[vfoIdx].to = to;
+    _lockWait[vfoIdx].what = (cross ? SI_WAIT_BAND : 0) | ((_events && (wrote || reset)) ? SI_WAIT_EVENT : 0) |
+                             ((cross || reset) ? SI_WAIT_LOCK : 0);
+    if (!cross && !reset) _lockCheck(vfoIdx, false); // A numerator step stays locked: published at once
+    if (_bandCount) {
+        _band[vfoIdx] = to;
+        _bandKnown |= 1 << vfoIdx;
+    }
+    return true;
+}
+
+// Publish the lock confirmation a VFO owes once the status shows lock, or as not locked after
+// SI_LOCK_TIMEOUT_US or when a newer update() replaces it (force). False while still pending.
+bool Si5351::_lockCheck(uint8_t vfoIdx, bool force) {
+    lock_wait_t& w = _lockWait[vfoIdx];
+    if (!w.what) return true;
+    bool ok = true;
+    if (w.what & SI_WAIT_LOCK) {
+        ok = locked(vfoIdx);
+        if (!ok && !force && micros() - w.start <= SI_LOCK_TIMEOUT_US) return false;
+        w.e.locked = micros();
+    }
+    if ((w.what & SI_WAIT_BAND) && _bandHook) _bandHook(_bandCtx, vfoIdx, w.from, w.to, ok ? SI_BAND_LOCKED : SI_BAND_NOLOCK);
+    if ((w.what & SI_WAIT_EVENT) && _events) {
+        w.e.seq = _eventSeq++;
+        if (!ok) w.e.flags |= SI_LO_NOLOCK;
+        _events->push(w.e);
+    }
+    w.what = 0;
+    return true;
+}
+
+bool Si5351::pollLock() {
+    bool pending = false;
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        if (!_lockCheck(i, false)) pending = true;
+    }
+    return pending;
+}
+
+void Si5351::setBands(const uint32_t* edges, uint8_t n) {
+    _bandEdges = edges;
+    _bandCount = edges ? n : 0;
+    _bandKnown = 0; // The next update() of each VFO reports its band
+}
+
+uint8_t Si5351::band(uint32_t freqHz) const {
+    uint8_t i = 0;
+    while (i < _bandCount && freqHz >= _bandEdges[i]) i++;
+    return i;
+}
+
+bool Si5351::locked(uint8_t vfoIdx) {
+    uint8_t lol = vfoIdx == 0 ? SI_STATUS_LOL_A : SI_STATUS_LOL_B;
+    return !(_rd(SI_STATUS) & (lol | SI_STATUS_SYS_INIT));
+}
+
+bool Si5351::waitLock(uint8_t vfoIdx, uint32_t timeoutUs) {
+    uint32_t t0 = micros();
+    while (!locked(vfoIdx)) {
+        if (micros() - t0 > timeoutUs) return false;
+    }
+    return true;
+}
+
+// ============ Clock Plans ============
+
+bool Si5351::apply(const si_clock_plan_t& p) {
+    for (uint8_t k = 0; k < 3; k++) {
+        if (!p.freq[k]) continue;
+        if (p.pll[k] > 1 || !p.msna[p.pll[k]] || !p.msc[k] || p.msb[k] >= p.msc[k] || p.msc[k] > SI_MS_C_MAX) return false;
+        if (p.msa[k] < 4 || p.msa[k] > SI_MS_MAX || (p.msa[k] < SI_MS_MIN_FRAC && (p.msb[k] || (p.msa[k] & 1)))) return false;
+        if (!p.ri[k] || (p.ri[k] & (p.ri[k] - 1))) return false;
+    }
+    bool quad = p.phase != SI_PLAN_FREE;
+    if (quad && (p.phase > PH270 || !p.freq[0] || p.pll[1] != p.pll[0] || p.msb[0] || p.msa[0] > 126 ||
+                 (p.msa[0] & 1) || p.msa[1] != p.msa[0] || p.msb[1] || p.ri[1] != p.ri[0])) return false;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        if (p.msna[i]) _setMSN(i, p.msna[i], p.msnb[i]);
+    }
+    for (uint8_t k = 0; k < 3; k++) {
+        if (!p.freq[k]) {
+            _src[k] = SI_CLK_PDN; // Not used, power it down
+            continue;
+        }
+        uint8_t buf[8];
+        encodeMS(buf, p.msa[k], p.msb[k], p.msc[k], _rDivToCode(p.ri[k]));
+        _stage(SI_SYNTH_MS0 + 8 * k, buf, 8);
+        bool even = p.msb[k] == 0 && !(p.msa[k] & 1); // Integer mode needs an even integer divider
+        _src[k] = (p.pll[k] ? SI_CLK_PLLB : 0) | (even ? SI_CLK_INT : 0);
+    }
+    _stage(SI_CLK0_PHOFF, 0);
+    _stage(SI_CLK1_PHOFF, quad && (p.phase == PH090 || p.phase == PH270) ? (uint8_t)p.msa[0] : 0);
+    _vfo[0].phase = quad ? p.phase : PH000; // CLK1 inversion for 180°/270°
+    _fracVco = 0; // The plan decides CLK2 from now on
+
+    // VFO settings the plan can express
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        uint8_t k = i == 0 ? 0 : 2;
+        vfo_t& v = _vfo[i];
+        bool same = p.freq[k] && p.pll[k] == i && p.msb[k] == 0 && p.msa[k] <= 126 && !(p.msa[k] & 1) &&
+                    (i == 1 || quad || (p.freq[1] == p.freq[0] && p.pll[1] == 0 && p.msa[1] == p.msa[0]));
+        v.freq = same ? p.freq[k] : 0;
+        v.ri = same ? p.ri[k] : 1;
+        v.msi = same ? (uint8_t)p.msa[k] : 0;
+        v.msna = same ? p.msna[i] : 0;
+        v.msnb = same ? p.msnb[i] : 0;
+    }
+
+    uint8_t reset = 0;
+    if (quad && (_pending(SI_SYNTH_MS0, 16) || _pending(SI_CLK0_PHOFF, 2))) {
+        reset = p.pll[0] ? SI_PLL_RESET_B : SI_PLL_RESET_A; // Realign the pair
+    }
+    _stageCtl(0);
+    _stageCtl(1);
+    return _commit() && (!reset || _resetPLL(reset));
+}
+
+// Status (read-only) and the PLL reset are left out of the bursts; the reset is issued once at the end
+bool Si5351::load(const uint8_t* regs, const uint8_t* mask) {
+    uint8_t oe = _next[SI_CLK_OE];
+    _stage(SI_CLK_OE, 0xFF); // All outputs off while the map goes in
+    if (!_commit()) {
+        _stage(SI_CLK_OE, oe); // Nothing of the map was sent, leave the outputs alone
+        return false;
+    }
+    for (uint8_t r = 0; r < SI_REG_COUNT; r++) {
+        if (!(mask[r >> 3] & (1 << (r & 7))) || r == SI_STATUS || r == SI_CLK_OE || r == SI_PLL_RESET) continue;
+        _stage(r, regs[r]);
+    }
+    bool ok = _commit() && _resetPLL(SI_PLL_RESET_A | SI_PLL_RESET_B);
+    if (ok) {
+        if (mask[SI_CLK_OE >> 3] & (1 << (SI_CLK_OE & 7))) oe = regs[SI_CLK_OE];
+        _stage(SI_CLK_OE, oe);
+        ok = _commit();
+    }
+
+    // The map owns the outputs now
+    for (uint8_t k = 0; k < 3; k++) {
+        uint8_t ctl = _next[SI_CLK0_CTL + k];
+        _src[k] = ctl & (SI_CLK_PDN | SI_CLK_INT | SI_CLK_PLLB);
+        _drive[k] = ctl & SI_CLK_IDRV;
+    }
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        vfo_t& v = _vfo[i];
+        v.freq = 0;
+        v.phase = PH000;
+        v.ri = 1;
+        v.msi = 0;
+        v.msna = 0;
+        v.msnb = 0;
+    }
+    _fracVco = 0;
+    return ok;
+}
+
+// Switching re-plans VFO1 for its current target in the new mode; update() applies it
+bool Si5351::setFractional(uint8_t vfoIdx, bool on, uint32_t vcoHz) {
+#if SI5351_VFO_COUNT > 1
+    if (vfoIdx != 1) return false;
+    uint64_t lo, hi;
+    if (on) {
+        if (!vcoWindow(_xtal, lo, hi)) return false;
+        if (!vcoHz) vcoHz = (SI_VCO_TARGET + _xtal / 2) / _xtal * _xtal;
+        if (vcoHz < lo || vcoHz > hi) return false;
+    }
+    uint32_t f = _vfo[1].freq;
+    uint32_t old = _fracVco;
+    _fracVco = on ? vcoHz : 0;
+    _vfo[1].freq = 0; // Force planning in the new mode
+    if (f && !_evaluate(1, f)) {
+        _fracVco = old; // The target cannot be reached in this mode
+        _vfo[1].freq = f;
+        return false;
+    }
+    return true;
+#else
+    (void)vfoIdx; (void)on; (void)vcoHz;
+    return false;
+#endif
+}
+
+// Best approximation b/c of n/d (n < d) with c <= SI_MS_C_MAX: the last continued fraction
+// convergent that fits, or the semiconvergent after it when that is closer
+static void ratio(uint64_t n, uint64_t d, uint32_t& b, uint32_t& c) {
+    uint64_t p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+    while (d) {
+        uint64_t a = n / d;
+        if (q1 && a > (SI_MS_C_MAX - q0) / q1) {
+            uint64_t k = (SI_MS_C_MAX - q0) / q1;
+            if (2 * k > a) { // Semiconvergent p0 + k p1 / q0 + k q1 is the better one
+                p1 = p0 + k * p1;
+                q1 = q0 + k * q1;
+            }
+            break;
+        }
+        uint64_t p2 = a * p1 + p0, q2 = a * q1 + q0;
+        p0 = p1; q0 = q1;
+        p1 = p2; q1 = q2;
+        uint64_t t = n % d;
+        n = d;
+        d = t;
+    }
+    b = (uint32_t)p1;
+    c = (uint32_t)q1;
+}
+
+// Smallest R that brings the divider under 2048; above 8 any fraction works, below only 4 and 6 exactly
+SI5351_HOT bool Si5351::planFractional(uint32_t xtalHz, uint32_t msna, uint32_t msnb, uint32_t freqHz,
+                                       uint8_t& ri, uint32_t& a, uint32_t& b, uint32_t& c) {
+    if (!freqHz || !msna) return false;
+    uint64_t num = (uint64_t)xtalHz * ((uint64_t)msna * SI_PLL_C + msnb); // VCO * SI_PLL_C
+    for (uint32_t r = 1; r <= 128; r <<= 1) {
+        uint64_t den = (uint64_t)SI_PLL_C * freqHz * r;
+        uint64_t ma = num / den;
+        uint64_t rem = num % den;
+        if (ma > SI_MS_MAX || (ma == SI_MS_MAX && rem)) continue;
+        if (ma < SI_MS_MIN_FRAC && (rem || (ma != 4 && ma != 6))) return false; // Too fast for this VCO
+        uint32_t mb = 0, mc = 1;
+        if (rem) ratio(rem, den, mb, mc);
+        if (mb == mc) { // Rounded up to the next integer
+            ma++;
+            mb = 0;
+        }
+        if (mb == 0) mc = 1;
+        ri = (uint8_t)r;
+        a = (uint32_t)ma;
+        b = mb;
+        c = mc;
+        return true;
+    }
+    return false; // Too slow even with R = 128
+}
+
+// ============ Internal Configuration Functions ============
+
+// Stage all registers of a VFO; a fine step usually changes only the PLL numerator, which
+// needs no reset, while a new MultiSynth divider or phase offset needs one to align the outputs
+SI5351_HOT uint8_t Si5351::_stageVfo(uint8_t vfoIdx) {
+    // Configure PLL multiplier (MSN) for the selected VFO
+    _setMSN(vfoIdx == 0 ? 0 : 1, _vfo[vfoIdx].msna, _vfo[vfoIdx].msnb);
+
+    if (vfoIdx == 0) {
+        _src[0] = _src[1] = SI_CLK_INT; // PLLA, integer mode
+        // VFO0 controls CLK0 and CLK1 with the same MultiSynth divider in integer mode
+        uint8_t rcode = _rDivToCode(_vfo[0].ri); // Get R divider code
+        _setMSI(0, _vfo[0].msi, rcode); // Configure CLK0 MultiSynth
+        _setMSI(1, _vfo[0].msi, rcode); // Configure CLK1 MultiSynth
+
+        // Set phase offset for quadrature output (90° shift if needed)
+        _stage(SI_CLK0_PHOFF, 0); // Reset CLK0 phase offset
+        _stage(SI_CLK1_PHOFF, (_vfo[0].phase == PH090 || _vfo[0].phase == PH270) ? _vfo[0].msi : 0); // Set CLK1 phase
+
+        // Configure clock control registers, including inversion for 180°/270° phase
+        _stageCtl(0);
+
+        bool reset = _pending(SI_SYNTH_MS0, 16) || _pending(SI_CLK0_PHOFF, 2);
+        return reset ? SI_PLL_RESET_A : 0;
+    }
+
+#if SI5351_VFO_COUNT > 1
+    // VFO1 controls CLK2
+    if (_fracVco) { // Fractional mode: PLLB does not move, only MS2 changes, nothing to realign
+        uint8_t buf[8];
+        encodeMS(buf, _ms2.a, _ms2.b, _ms2.c, _rDivToCode(_vfo[1].ri));
+        _stage(SI_SYNTH_MS2, buf, 8);
+        _src[2] = SI_CLK_PLLB | ((_ms2.b == 0 && !(_ms2.a & 1)) ? SI_CLK_INT : 0);
+        _stageCtl(1);
+        return 0;
+    }
+    _src[2] = SI_CLK_INT | SI_CLK_PLLB;
+    uint8_t rcode = _rDivToCode(_vfo[1].ri); // Get R divider code
+    _setMSI(2, _vfo[1].msi, rcode); // Configure CLK2 MultiSynth
+
+    // Configure CLK2 to use PLLB in integer mode
+    _stageCtl(1);
+
+    return _pending(SI_SYNTH_MS2, 8) ? SI_PLL_RESET_B : 0;
+#else
+    return 0;
+#endif
+}
+
+// All CLKx_CTL bytes are composed here: MultiSynth source, PLL and integer mode of the output,
+// CLK1 inverted for 180°/270°, drive strength, and power-down for unused outputs
+SI5351_HOT uint8_t Si5351::_ctl(uint8_t clkIdx, bool powerUp) const {
+    uint8_t vfoIdx = clkIdx < 2 ? 0 : 1;
+    if (vfoIdx >= SI5351_VFO_COUNT) return SI_CLK_PDN; // Output not compiled in
+    const vfo_t& v = _vfo[vfoIdx];
+
+    uint8_t ctl = SI_CLK_SRC_MS | _src[clkIdx];
+    if (clkIdx == 1 && (v.phase == PH180 || v.phase == PH270)) ctl |= SI_CLK_INV;
+    if (_powerSave && !powerUp && !isEnabled(vfoIdx)) ctl |= SI_CLK_PDN;
+
+    uint8_t drive = _drive[clkIdx];
+    const si_drive_band_t* table = _driveTable[vfoIdx];
+    if (table) {
+        uint8_t i = 0;
+        while (i + 1 < _driveBands[vfoIdx] && v.freq > table[i].maxHz) i++;
+        drive = table[i].drive;
+    }
+    return ctl | (drive & SI_CLK_IDRV);
+}
+
+SI5351_HOT void Si5351::_stageCtl(uint8_t vfoIdx, bool powerUp) {
+    if (vfoIdx == 0) {
+        _stage(SI_CLK0_CTL, _ctl(0, powerUp));
+        _stage(SI_CLK1_CTL, _ctl(1, powerUp));
+    } else {
+        _stage(SI_CLK2_CTL, _ctl(2, powerUp));
+    }
+}
+
+// Configure PLL multiplier (MSN = a + b/c) for a specified PLL (0 for PLLA, 1 for PLLB)
+SI5351_HOT void Si5351::_setMSN(uint8_t pllIdx, uint32_t a, uint32_t b) {
+    // Prepare register data for PLL configuration
+    uint8_t base = (pllIdx == 0) ? SI_SYNTH_PLLA : SI_SYNTH_PLLB; // Select PLLA or PLLB base register
+    uint8_t buf[8];
+    encodeMSN(buf, a, b, SI_PLL_C);
+
+    _stage(base, buf, 8); // Stage the PLL configuration registers
+}
+
+// Configure MultiSynth divider for a specific clock output in integer mode
+SI5351_HOT void Si5351::_setMSI(uint8_t clkIdx, uint8_t msiEven, uint8_t rDivLog2) {
+    uint8_t base = (clkIdx == 0) ? SI_SYNTH_MS0 : (clkIdx == 1 ? SI_SYNTH_MS1 : SI_SYNTH_MS2); // Select MultiSynth base register
+
+    // Prepare register data for MultiSynth configuration
+    uint8_t buf[8];
+    encodeMSI(buf, msiEven, rDivLog2);
+
+    _stage(base, buf, 8); // Stage the MultiSynth configuration registers
+}
+
+// ============ Register Image Encoders ============
+
+// Encode a divider a + b/c into P1/P2/P3 (AN619 section 3.2) and lay them out as 8 register bytes
+SI5351_HOT void Si5351::encodeMSN(uint8_t* buf, uint32_t a, uint32_t b, uint32_t c) {
+    uint32_t tmp = (128UL * b) / c;           // floor(128 * b / c)
+    uint32_t P1 = 128UL * a + tmp - 512UL;    // P1 = 128a + floor(128b/c) - 512
+    uint32_t P2 = 128UL * b - c * tmp;        // P2 = 128b - c * floor(128b/c)
+    uint32_t P3 = c;                          // P3 = c
+
+    buf[0] = (P3 >> 8) & 0xFF; // P3[15:8]
+    buf[1] = P3 & 0xFF;        // P3[7:0]
+    buf[2] = (P1 >> 16) & 0x03; // P1[17:16]
+    buf[3] = (P1 >> 8) & 0xFF; // P1[15:8]
+    buf[4] = P1 & 0xFF;        // P1[7:0]
+    buf[5] = ((P3 >> 12) & 0xF0) | ((P2 >> 16) & 0x0F); // P3[19:16] | P2[19:16]
+    buf[6] = (P2 >> 8) & 0xFF; // P2[15:8]
+    buf[7] = P2 & 0xFF;        // P2[7:0]
+}
+
+// Encode an integer MultiSynth divider with its R divider code (P2=0, P3=1)
+SI5351_HOT void Si5351::encodeMSI(uint8_t* buf, uint8_t msi, uint8_t rDivLog2) {
+    encodeMS(buf, msi, 0, 1, rDivLog2);     // P1 = 128 * msi - 512, P2 = 0, P3 = 1
+}
+
+// A MultiSynth divider has the same P1/P2/P3 layout as a PLL, plus the R divider and DIVBY4 bits
+SI5351_HOT void Si5351::encodeMS(uint8_t* buf, uint32_t a, uint32_t b, uint32_t c, uint8_t rDivLog2) {
+    encodeMSN(buf, a, b, c);
+    buf[2] |= (rDivLog2 & 0x07) << 4;            // P1[17:16] | R divider bits
+    if (a == 4 && b == 0) buf[2] |= SI_MS_DIVBY4; // Divide by 4 also needs MSx_DIVBY4=11 (AN619 section 4.1.3)
+}
+
+// Calculate optimal parameters for a desired output frequency
+SI5351_HOT bool Si5351::_evaluate(uint8_t vfoIdx, uint32_t freqHz) {
+    if (vfoIdx >= SI5351_VFO_COUNT) return false; // Invalid VFO
+    if (_vfo[vfoIdx].freq == freqHz) return true; // Skip if frequency unchanged
+
+    vfo_t v = _vfo[vfoIdx];
+#if SI5351_VFO_COUNT > 1
+    if (isFractional(vfoIdx)) {
+        // Fixed PLL multiplier for the VCO, then only the MultiSynth divider
+        uint32_t a = _fracVco / _xtal;
+        uint32_t b = (uint32_t)(((uint64_t)(_fracVco % _xtal) * SI_PLL_C + _xtal / 2) / _xtal);
+        if (b >= SI_PLL_C) { a++; b -= SI_PLL_C; }
+        uint8_t ri;
+        uint32_t ma, mb, mc;
+        if (!planFractional(_xtal, a, b, freqHz, ri, ma, mb, mc)) return false;
+        v.freq = freqHz;
+        v.ri = ri;
+        v.msi = 0; // No integer divider in this mode
+        v.msna = a;
+        v.msnb = b;
+        _vfo[vfoIdx] = v;
+        _ms2.a = ma;
+        _ms2.b = mb;
+        _ms2.c = mc;
+        return true;
+    }
+#endif
+    if (!_planVfo(vfoIdx, freqHz, v)) return false; // Keep the previous settings if unreachable
+    _vfo[vfoIdx] = v; // Store calculated parameters in VFO structure
+    return true;
+}
+
+SI5351_HOT bool Si5351::_avoided(uint64_t vcoHz) const {
+    for (uint8_t i = 0; i < _vcoZoneCount; i++) {
+        if (vcoHz >= _vcoZones[i].loHz && vcoHz <= _vcoZones[i].hiHz) return true;
+    }
+    return false;
+}
+
+// v holds the current settings of the VFO on entry. Without a mode or zones this is plan() with
+// the band's VCO target; otherwise every usable even divider is scored, dividers that put the VCO
+// in an avoided zone only winning when nothing else fits.
+SI5351_HOT bool Si5351::_planVfo(uint8_t vfoIdx, uint32_t freqHz, vfo_t& v) const {
+    uint32_t target = SI_VCO_TARGET;
+    const si_vco_band_t* table = _vcoTable[vfoIdx];
+    if (table) {
+        uint8_t i = 0;
+        while (i + 1 < _vcoBands[vfoIdx] && freqHz > table[i].maxHz) i++;
+        if (table[i].vcoHz) target = table[i].vcoHz;
+    }
+    uint8_t mode = _vcoMode[vfoIdx];
+    if (mode == SI_VCO_NEAREST && !_vcoZoneCount) return planVco(_xtal, freqHz, target, v);
+
+    vfo_t keep = v;
+    if (mode == SI_VCO_SPAN && v.msi && planDivider(_xtal, freqHz, v.ri, v.msi, keep) &&
+        !_avoided((uint64_t)freqHz * v.ri * v.msi)) {
+        v = keep; // Same dividers: only the PLL multiplier changes, no reset
+        return true;
+    }
+
+    uint8_t ri, lo, hi;
+    uint64_t vcoLo, vcoHi;
+    if (!dividerRange(_xtal, freqHz, ri, lo, hi) || !vcoWindow(_xtal, vcoLo, vcoHi)) return false;
+    uint8_t best = 0;
+    bool bestClear = false;
+    uint64_t bestCost = 0;
+    for (uint8_t msi = lo; msi <= hi; msi += 2) {
+        uint64_t vco = (uint64_t)freqHz * ri * msi;
+        uint64_t cost;
+        if (mode == SI_VCO_SPAN) {
+            // Reset-free span on the narrower side, relative to the frequency: the VCO can move
+            // down to vcoLo and up to vcoHi with this divider
+            uint64_t margin = vco - vcoLo < vcoHi - vco ? vco - vcoLo : vcoHi - vco;
+            cost = (1ULL << 20) - (margin << 20) / vco;
+        } else {
+            cost = vco > target ? vco - target : target - vco;
+        }
+        bool clear = !_avoided(vco);
+        if (!best || (clear && !bestClear) || (clear == bestClear && cost < bestCost)) {
+            best = msi;
+            bestClear = clear;
+            bestCost = cost;
+        }
+    }
+    return planDivider(_xtal, freqHz, ri, best, v);
+}
+
+// Pure planner: all arithmetic is exact integer math, so the result only depends on its inputs
+SI5351_HOT bool Si5351::plan(uint32_t xtalHz, uint32_t freqHz, vfo_t& out) {
+    return planVco(xtalHz, freqHz, SI_VCO_TARGET, out);
+}
+
+SI5351_HOT bool Si5351::planVco(uint32_t xtalHz, uint32_t freqHz, uint32_t vcoHz, vfo_t& out) {
+    if (freqHz == 0 || xtalHz == 0) return false;
+
+    // Strategy: Target VCO frequency around vcoHz, use even integer MultiSynth divider (4-126),
+    // and use the smallest R divider that still lets the largest divider reach the VCO range
+    uint64_t vcoLo, vcoHi;
+    if (!vcoWindow(xtalHz, vcoLo, vcoHi)) return false; // Crystal frequency outside the usable range
+
+    uint32_t ri = 1; // R divider
+    while ((uint64_t)freqHz * ri * 126 < vcoLo) {
+        if (ri == 128) return false; // Below ~25 kHz even R=128 cannot reach the VCO range
+        ri <<= 1;
+    }
+
+    // Calculate divider to target the VCO frequency
+    uint64_t fout = (uint64_t)freqHz * ri; // MultiSynth output frequency before the R divider
+    uint64_t tentative = vcoHz / fout;
+    if (tentative < 4) tentative = 4; // Ensure divider is at least 4
+    if (tentative & 1) tentative++; // Make even if odd
+    if (tentative > 126) tentative = 126; // Cap at 126
+
+    // Move the divider back inside the VCO window if the target pushed it out
+    while (tentative > 4 && fout * tentative > vcoHi) tentative -= 2;
+    while (tentative < 126 && fout * tentative < vcoLo) tentative += 2;
+    return planDivider(xtalHz, freqHz, (uint8_t)ri, (uint8_t)tentative, out);
+}
+
+// The usable VCO window is limited both by the VCO itself and by the MSN range for this crystal
+bool Si5351::vcoWindow(uint32_t xtalHz, uint64_t& lo, uint64_t& hi) {
+    lo = (uint64_t)xtalHz * SI_MSN_MIN;
+    hi = (uint64_t)xtalHz * SI_MSN_MAX;
+    if (lo < SI_VCO_LO) lo = SI_VCO_LO;
+    if (hi > SI_VCO_HI) hi = SI_VCO_HI;
+    return xtalHz && lo <= hi;
+}
+
+// Same R choice as plan(); the VCO grows with the divider, so the usable ones form a range
+bool Si5351::dividerRange(uint32_t xtalHz, uint32_t freqHz, uint8_t& ri, uint8_t& msiLo, uint8_t& msiHi) {
+    uint64_t vcoLo, vcoHi;
+    if (!vcoWindow(xtalHz, vcoLo, vcoHi) || freqHz == 0) return false;
+    uint32_t r = 1;
+    while ((uint64_t)freqHz * r * 126 < vcoLo) {
+        if (r == 128) return false;
+        r <<= 1;
+    }
+    uint64_t fout = (uint64_t)freqHz * r;
+    uint64_t lo = (vcoLo + fout - 1) / fout; // Smallest divider reaching vcoLo
+    uint64_t hi = vcoHi / fout;              // Largest divider staying under vcoHi
+    lo += lo & 1;
+    hi -= hi & 1;
+    if (lo < 4) lo = 4;
+    if (hi > 126) hi = 126;
+    if (lo > hi) return false;
+    ri = (uint8_t)r;
+    msiLo = (uint8_t)lo;
+    msiHi = (uint8_t)hi;
+    return true;
+}
+
+// PLL multiplier for given output dividers, e.g. to keep a divider across channels
+SI5351_HOT bool Si5351::planDivider(uint32_t xtalHz, uint32_t freqHz, uint8_t ri, uint8_t msi, vfo_t& out) {
+    uint64_t vcoLo, vcoHi;
+    if (!vcoWindow(xtalHz, vcoLo, vcoHi) || freqHz == 0) return false;
+    if (msi < 4 || msi > 126 || (msi & 1) || ri == 0 || (ri & (ri - 1))) return false;
+    uint64_t fvco = (uint64_t)freqHz * ri * msi;
+    if (fvco < vcoLo || fvco > vcoHi) return false; // Above ~225 MHz no divider fits
+
+    // Calculate PLL multiplier (MSN = a + b/c) based on crystal frequency, rounded to the nearest b
+    uint64_t a = fvco / xtalHz;
+    uint64_t b = ((fvco % xtalHz) * SI_PLL_C + xtalHz / 2) / xtalHz;
+    if (b >= SI_PLL_C) { a++; b -= SI_PLL_C; } // Rounding carried into the integer part
+    if (a > SI_MSN_MAX || (a == SI_MSN_MAX && b)) return false; // Rounded past the top of the MSN range
+
+    out.freq = freqHz;
+    out.ri = ri;
+    out.msi = msi;
+    out.msna = (uint32_t)a;
+    out.msnb = (uint32_t)b;
+    return true;
+}
\ No newline at end of file
@@ -1,111 +1,531 @@
-#ifndef _SI5351_H_
-#define _SI5351_H_
-/*
- * si5351.h
- *
- * Created: August 2025
- * Author: Anton W. Zimakos (aka UN8JAB)
- *
- * Driver for Si5351A chip.
- * VFO 0 quadrature for CLK0 and CLK1,
- * VFO 1 simple for CLK2.
- *
- * VFO 0 set frequency and phase 0-90-180-270 deg
- * VFO 1 set frequency, phase is ignored
- *
- * To get smooth tuning, a suggested interval is 100ms
- *
- */
-
-#include <Wire.h>
-
-// Phase settings for quadrature output (CLK1 relative to CLK0)
-#define PH000 0 // 0° phase shift
-#define PH090 1 // 90° phase shift
-#define PH180 2 // 180° phase shift
-#define PH270 3 // 270° phase shift
-
-// SI5351 register addresses
-#define SI5351_ADDR     0x60 // I2C address of the SI5351 chip
-#define SI_CLK_OE       3    // Output enable control register
-#define SI_CLK0_CTL     16   // CLK0 control register
-#define SI_CLK1_CTL     17   // CLK1 control register
-#define SI_CLK2_CTL     18   // CLK2 control register
-#define SI_SYNTH_PLLA   26   // PLLA synthesizer base register
-#define SI_SYNTH_PLLB   34   // PLLB synthesizer base register
-#define SI_SYNTH_MS0    42   // MultiSynth 0 base Piregister base address (CLK0)
-#define SI_SYNTH_MS1    50   // MultiSynth 1 register base address (CLK1)
-#define SI_SYNTH_MS2    58   // MultiSynth 2 register base address (CLK2)
-#define SI_SS_EN        149  // Spread spectrum enable register
-#define SI_CLK0_PHOFF   165  // CLK0 phase offset register
-#define SI_CLK1_PHOFF   166  // CLK1 phase offset register
-#define SI_CLK2_PHOFF   167  // CLK2 phase offset register
-#define SI_PLL_RESET    177  // PLL reset register
-#define SI_XTAL_LOAD    183  // Crystal load capacitance register
-
-// Bit fields for CLKi_CTL registers
-#define SI_CLK_INT      0b01000000 // Enable integer mode (required for integer MultiSynth divider)
-#define SI_CLK_PLLB     0b00100000 // Select PLLB as clock source (0 = PLLA)
-#define SI_CLK_INV      0b00010000 // Invert the clock output
-#define SI_CLK_SRC_MS   0b00001100 // Select MultiSynth as clock source (otherwise XTAL)
-#define SI_CLK_IDRV_4mA 0b00000001 // Set output drive strength to 4mA
-
-// VCO/PLL frequency limits and fractional denominator
-#define SI_VCO_LO       400000000UL // Minimum VCO frequency (400 MHz, relaxed from 600 MHz datasheet spec)
-#define SI_VCO_HI       900000000UL // Maximum VCO frequency (900 MHz)
-#define SI_PLL_C        1000000UL   // Denominator for PLL fractional multiplier (b/c)
-
-// Structure to store VFO configuration
-typedef struct {
-    uint32_t freq;  // Target frequency in Hz
-    uint8_t  phase; // Quadrature phase (0°, 90°, 180°, or 270°)
-    uint8_t  ri;    // R divider value (1, 2, 4, 8, 16, 32, 64, 128)
-    uint8_t  msi;   // MultiSynth integer divider (even, 4 to 126)
-    double   msn;   // PLL multiplier (a + b/c)
-} vfo_t;
-
-class Si5351 {
-public:
-    // Constructor: Initialize with crystal frequency (default 25 MHz, can be customized)
-    explicit Si5351(uint32_t xtalFreq = 25000000UL)
-      : _xtal(xtalFreq) {}
-
-    // Initialize I2C and configure the SI5351 chip
-    void begin();
-
-    // Reset both PLLA and PLLB
-    void resetPLL();
-
-    // Enable or disable a VFO (0 = CLK0+CLK1, 1 = CLK2)
-    void enable(uint8_t vfoIdx, bool en);
-
-    // Set phase for VFO0 (CLK1 relative to CLK0)
-    void setPhase(uint8_t vfoIdx, uint8_t phase);
-
-    // Set the desired frequency in Hz (registers updated by update())
-    void setFreq(uint8_t vfoIdx, uint32_t freqHz);
-
-    // Calculate and write all necessary registers for a VFO
-    void update(uint8_t vfoIdx);
-
-private:
-    uint32_t _xtal; // Crystal frequency in Hz
-    vfo_t _vfo[2];  // VFO configurations: 0 for CLK0/CLK1 (quadrature), 1 for CLK2
-
-    // Low-level I2C communication functions
-    void _wr(uint8_t reg, uint8_t val); // Write a single byte to a register
-    void _wrBulk(uint8_t reg, const uint8_t* data, uint8_t len); // Write multiple bytes to consecutive registers
-    uint8_t _rd(uint8_t reg); // Read a single byte from a register
-
-    // PLL and MultiSynth configuration functions
-    void _setMSN(uint8_t pllIdx, double msn); // Configure PLL multiplier
-    void _setMSI(uint8_t clkIdx, uint8_t msiEven, uint8_t rDivLog2); // Configure MultiSynth divider
-
-    // Calculate parameters for a target frequency
-    void _evaluate(uint8_t vfoIdx, uint32_t freqHz);
-
-    // Convert R divider value to its code (1, 2, 4, ..., 128 -> 0..7)
-    static uint8_t _rDivToCode(uint8_t r);
-};
-
+#ifndef _SI5351_H_
+#define _SI5351_H_
+/*
+ * si5351.h
+ *
+ * Created: August 2025
+ * Author: Anton W. Zimakos (aka UN8JAB)
+ *
+ * Driver for Si5351A chip.
+ * VFO 0 quadrature for CLK0 and CLK1,
+ * VFO 1 simple for CLK2.
+ *
+ * VFO 0 set frequency and phase 0-90-180-270 deg
+ * VFO 1 set frequency, phase is ignored
+ *
+ * To get smooth tuning, a suggested interval is 100ms
+ *
+ */
+
+#include <Wire.h>
+#include "si5351_bus.h"
+
+// Build profile options (set them in build_flags):
+//   SI5351_VFO_COUNT=1  only VFO0 (quadrature CLK0/CLK1) exists, VFO1/CLK2 code is not compiled
+//   SI5351_MINIMAL      packed VFO state and no bus traffic counters
+#ifndef SI5351_VFO_COUNT
+#define SI5351_VFO_COUNT 2
+#endif
+
+// Define SI5351_RAM_HOTPATH to place the tuning hot path (planner, encoders, register image and
+// bus write functions) in SRAM on RP2040, so its latency does not depend on XIP flash cache
+// misses. The Wire library and runtime helpers it calls stay wherever the core puts them.
+#if defined(SI5351_RAM_HOTPATH) && defined(ARDUINO_ARCH_RP2040)
+#define SI5351_HOT __attribute__((noinline, section(".time_critical.si5351")))
+#else
+#define SI5351_HOT
+#endif
+
+// Phase settings for quadrature output (CLK1 relative to CLK0)
+#define PH000 0 // 0° phase shift
+#define PH090 1 // 90° phase shift
+#define PH180 2 // 180° phase shift
+#define PH270 3 // 270° phase shift
+
+// SI5351 register addresses
+#define SI5351_ADDR     0x60 // I2C address of the SI5351 chip
+#define SI_STATUS       0    // Device status register
+#define SI_CLK_OE       3    // Output enable control register
+#define SI_CLK0_CTL     16   // CLK0 control register
+#define SI_CLK1_CTL     17   // CLK1 control register
+#define SI_CLK2_CTL     18   // CLK2 control register
+#define SI_CLK_DIS      24   // CLK3-0 disable state register (2 bits per output)
+#define SI_SYNTH_PLLA   26   // PLLA synthesizer base register
+#define SI_SYNTH_PLLB   34   // PLLB synthesizer base register
+#define SI_SYNTH_MS0    42   // MultiSynth 0 base Piregister base address (CLK0)
+#define SI_SYNTH_MS1    50   // MultiSynth 1 register base address (CLK1)
+#define SI_SYNTH_MS2    58   // MultiSynth 2 register base address (CLK2)
+#define SI_SS_EN        149  // Spread spectrum enable register
+#define SI_CLK0_PHOFF   165  // CLK0 phase offset register
+#define SI_CLK1_PHOFF   166  // CLK1 phase offset register
+#define SI_CLK2_PHOFF   167  // CLK2 phase offset register
+#define SI_PLL_RESET    177  // PLL reset register
+#define SI_XTAL_LOAD    183  // Crystal load capacitance register
+#define SI_SCRATCH      150  // Spread spectrum parameters 150..155, inert while SS_EN is 0: bus probe scratch
+#define SI_SCRATCH_LEN  6
+#define SI_REG_COUNT    188  // Number of registers mirrored by the driver (0..187)
+
+// Bit fields for the device status register
+#define SI_STATUS_SYS_INIT 0b10000000 // Device still initialising
+#define SI_STATUS_LOL_B    0b01000000 // PLLB loss of lock
+#define SI_STATUS_LOL_A    0b00100000 // PLLA loss of lock
+
+// Band-change hook points, in pipeline order
+#define SI_BAND_BEFORE  0 // New band planned, no register written yet
+#define SI_BAND_RELOCK  1 // Registers written and PLL reset issued, lock pending: switch slow filters here
+#define SI_BAND_LOCKED  2 // PLL lock confirmed
+#define SI_BAND_NOLOCK  3 // No lock within SI_LOCK_TIMEOUT_US
+
+#define SI_BAND_UNKNOWN 0xFF // fromBand of the first change after setBands()
+
+#define SI_LOCK_TIMEOUT_US 10000 // pollLock() reports no lock this long after a PLL reset or band change
+
+// Bit fields for the PLL reset register
+#define SI_PLL_RESET_A  0b00100000 // Reset PLLA
+#define SI_PLL_RESET_B  0b10000000 // Reset PLLB
+
+// Bit fields for CLKi_CTL registers
+#define SI_CLK_PDN      0b10000000 // Power down the clock output and its MultiSynth
+#define SI_CLK_INT      0b01000000 // Enable integer mode (required for integer MultiSynth divider)
+#define SI_CLK_PLLB     0b00100000 // Select PLLB as clock source (0 = PLLA)
+#define SI_CLK_INV      0b00010000 // Invert the clock output
+#define SI_CLK_SRC_MS   0b00001100 // Select MultiSynth as clock source (otherwise XTAL)
+#define SI_CLK_IDRV_4mA 0b00000001 // Set output drive strength to 4mA
+#define SI_CLK_IDRV     0b00000011 // Output drive strength field
+
+// Output drive strength, for setDrive() and drive tables
+#define SI_DRIVE_2MA    0
+#define SI_DRIVE_4MA    1
+#define SI_DRIVE_6MA    2
+#define SI_DRIVE_8MA    3
+
+// Output state while disabled, for setDisableState()
+#define SI_DIS_LOW      0 // Driven low
+#define SI_DIS_HIGH     1 // Driven high
+#define SI_DIS_HIZ      2 // High impedance
+#define SI_DIS_NEVER    3 // Never disabled, the output keeps running
+
+// Bit fields for the third byte of a MultiSynth block (MSx_P1[17:16] register)
+#define SI_MS_DIVBY4    0b00001100 // MultiSynth divide-by-4 mode (required when the divider is exactly 4)
+
+// MultiSynth divider limits (AN619): 4, 6 and 8 as integers, fractional from 8 up to 2048
+#define SI_MS_MIN_FRAC  8
+#define SI_MS_MAX       2048
+#define SI_MS_C_MAX     1048575UL // Largest fractional denominator (20 bits)
+
+// VCO/PLL frequency limits and fractional denominator
+#define SI_VCO_LO       400000000UL // Minimum VCO frequency (400 MHz, relaxed from 600 MHz datasheet spec)
+#define SI_VCO_HI       900000000UL // Maximum VCO frequency (900 MHz)
+#define SI_PLL_C        1000000UL   // Denominator for PLL fractional multiplier (b/c)
+#define SI_MSN_MIN      15          // Minimum PLL feedback multiplier integer part (AN619)
+#define SI_MSN_MAX      90          // Maximum PLL feedback multiplier integer part (AN619)
+#define SI_VCO_TARGET   700000000UL // Preferred VCO frequency used to pick the MultiSynth divider
+
+// Divider choice of setFreq(), for setVcoMode()
+#define SI_VCO_NEAREST  0 // Divider that puts the VCO nearest the target (default)
+#define SI_VCO_SPAN     1 // Keep the divider while it still reaches, else the widest reset-free span
+
+// Unchanged registers between two changed runs are rewritten instead of starting a new
+// transaction when the gap is at most this many bytes (a transaction costs ~2 extra bytes)
+#define SI_MERGE_GAP    2
+
+// Structure to store VFO configuration
+#ifdef SI5351_MINIMAL
+typedef struct {
+    uint32_t freq;       // Target frequency in Hz
+    uint32_t msnb  : 20; // PLL multiplier numerator b (denominator c = SI_PLL_C)
+    uint32_t msna  : 7;  // PLL multiplier integer part a (15 to 90)
+    uint32_t phase : 2;  // Quadrature phase (0°, 90°, 180°, or 270°)
+    uint8_t  ri;         // R divider value (1, 2, 4, 8, 16, 32, 64, 128)
+    uint8_t  msi;        // MultiSynth integer divider (even, 4 to 126)
+} vfo_t;
+#else
+typedef struct {
+    uint32_t freq;  // Target frequency in Hz
+    uint8_t  phase; // Quadrature phase (0°, 90°, 180°, or 270°)
+    uint8_t  ri;    // R divider value (1, 2, 4, 8, 16, 32, 64, 128)
+    uint8_t  msi;   // MultiSynth integer divider (even, 4 to 126)
+    uint32_t msna;  // PLL multiplier integer part a (15 to 90)
+    uint32_t msnb;  // PLL multiplier numerator b (denominator c = SI_PLL_C)
+} vfo_t;
+#endif
+
+// Clock plan for all three outputs (see Si5351Clocks): the PLL feeding each output and its
+// MultiSynth divider a + b/c, integer when b = 0
+#define SI_PLAN_FREE    0xFF // si_clock_plan_t.phase: CLK1 independent of CLK0
+
+typedef struct {
+    uint32_t freq[3];                // Target per output in Hz, 0 = output powered down
+    uint8_t  phase;                  // CLK1 relative to CLK0 (PH000..PH270, same frequency), or SI_PLAN_FREE
+    uint8_t  pll[3];                 // Source per output: 0 = PLLA, 1 = PLLB
+    uint8_t  ri[3];                  // R divider value per output
+    uint32_t msa[3], msb[3], msc[3]; // MultiSynth divider per output
+    uint32_t msna[2], msnb[2];       // PLLA and PLLB multipliers a + b/SI_PLL_C, msna 0 = not used
+} si_clock_plan_t;
+
+// Drive table entry: drive strength for VFO frequencies up to and including maxHz
+typedef struct {
+    uint32_t maxHz;
+    uint8_t  drive; // SI_DRIVE_2MA .. SI_DRIVE_8MA
+} si_drive_band_t;
+
+// VCO table entry: preferred VCO for VFO frequencies up to and including maxHz
+typedef struct {
+    uint32_t maxHz;
+    uint32_t vcoHz; // 0 = SI_VCO_TARGET
+} si_vco_band_t;
+
+// VCO range the divider choice keeps away from (e.g. a measured spur), in Hz
+typedef struct {
+    uint32_t loHz;
+    uint32_t hiHz;
+} si_vco_zone_t;
+
+// Band-change hook: called at each SI_BAND_* point of an update() that moves a VFO to another band
+typedef void (*si_band_hook_t)(void* ctx, uint8_t vfoIdx, uint8_t fromBand, uint8_t toBand, uint8_t point);
+
+// Timestamps of one update() that changed the chip, in micros() time
+typedef struct {
+    uint32_t seq;     // Update number; a gap means events were dropped on a full queue
+    uint32_t freq;    // Frequency produced after the update, in Hz
+    uint32_t written; // Last register write completed
+    uint32_t reset;   // PLL reset issued (same as written without a reset)
+    uint32_t locked;  // Lock seen by pollLock() (same as written without a reset: the PLL slews and stays locked)
+    uint8_t  vfo;     // VFO index
+    uint8_t  flags;   // SI_LO_RESET, SI_LO_NOLOCK
+} si_lo_event_t;
+
+#define SI_LO_RESET     0x01 // The update reset the PLL
+#define SI_LO_NOLOCK    0x02 // Lock not confirmed within SI_LOCK_TIMEOUT_US, locked is when pollLock() gave up
+
+#define SI_LO_QUEUE     8    // Events held by Si5351LoQueue (one slot is kept free)
+
+// Single-producer single-consumer event queue: the driver pushes from update() and pollLock(), another thread,
+// interrupt or core pops. No locks; the barrier publishes an event before the index that exposes it.
+class Si5351LoQueue {
+public:
+    bool push(const si_lo_event_t& e) {
+        uint8_t h = _head;
+        uint8_t next = (h + 1) % SI_LO_QUEUE;
+        if (next == _tail) { _dropped++; return false; } // Full
+        _buf[h] = e;
+        __sync_synchronize();
+        _head = next;
+        return true;
+    }
+
+    bool pop(si_lo_event_t& e) {
+        uint8_t t = _tail;
+        if (t == _head) return false; // Empty
+        __sync_synchronize();
+        e = _buf[t];
+        __sync_synchronize();
+        _tail = (t + 1) % SI_LO_QUEUE;
+        return true;
+    }
+
+    uint32_t dropped() const { return _dropped; } // Events lost on a full queue
+
+private:
+    si_lo_event_t _buf[SI_LO_QUEUE];
+    volatile uint8_t _head = 0;    // Written by the producer only
+    volatile uint8_t _tail = 0;    // Written by the consumer only
+    volatile uint32_t _dropped = 0;
+};
+
+// I2C rate probing
+#define SI_PROBE_MAX_HZ 1000000 // Default upper limit for probeBus()
+#define SI_PROBE_ROUNDS 8       // Write/readback rounds per rate
+
+// Bus traffic counters, accumulated since construction or the last clearStats()
+typedef struct {
+    uint32_t bytes;        // Bytes written, register address bytes included
+    uint32_t transactions; // Write transactions
+    uint32_t reads;        // Register read transactions
+    uint32_t resets;       // PLL reset commands
+    uint32_t errors;       // Write transactions the bus did not complete (NACK, too long)
+} si_stats_t;
+
+class Si5351 {
+public:
+    // Constructor: Initialize with crystal frequency (default 25 MHz, can be customized)
+    explicit Si5351(uint32_t xtalFreq = 25000000UL)
+      : _xtal(xtalFreq) {}
+
+    // I2C backend for all register traffic, e.g. a Si5351Arbiter shared with other devices.
+    // Set it before begin(); the default is the Wire object.
+    void setBus(Si5351Bus* bus) { _bus = bus ? bus : &_wire; }
+    Si5351Bus* bus() const { return _bus; }
+
+    // Let begin() raise the bus rate up to maxHz (0 = leave it to the bus backend), see probeBus()
+    void setBusProbe(uint32_t maxHz) { _probeHz = maxHz; }
+
+    // Try 100 kHz, 400 kHz, 1 MHz, 2 MHz and 3.4 MHz up to maxHz with write/readback of scratch
+    // registers, and keep the fastest rate that also passed 25% faster. Returns that rate, or 0
+    // (and 100 kHz) if the chip does not answer.
+    uint32_t probeBus(uint32_t maxHz = SI_PROBE_MAX_HZ);
+    uint32_t busClock() const { return _busHz; } // Rate chosen by the last probe, 0 if none
+
+    // Initialize I2C and configure the SI5351 chip. False if a write failed: the outputs stay off,
+    // call begin() again.
+    bool begin();
+
+    // Same, but start from saved VFO states (SI5351_VFO_COUNT entries, e.g. from a preset image);
+    // their dividers are only checked, not planned again. Invalid entries fall back to the defaults.
+    bool begin(const vfo_t* init);
+
+    // Change the crystal frequency (e.g. from a calibration table) and re-plan all VFOs
+    void setXtal(uint32_t xtalHz);
+    uint32_t getXtal() const { return _xtal; }
+
+    // Reset both PLLA and PLLB
+    void resetPLL();
+
+    // Write consecutive registers immediately, keeping the register mirror in sync. For engines that
+    // send pre-encoded register images; the VFO settings returned by getFreq() are not updated.
+    // False if the run does not lie within the register map (reg + len > SI_REG_COUNT, nothing is
+    // sent) or the bus did not complete the write; the mirror then keeps the old values.
+    bool writeRegs(uint8_t reg, const uint8_t* data, uint8_t len);
+
+    // Fractional MultiSynth mode for VFO1 (CLK2, no quadrature): PLLB stays at a fixed VCO and
+    // setFreq() plans only the MultiSynth divider, so update() rewrites the MS2 block alone and
+    // never resets the PLL. vcoHz 0 picks the whole crystal multiple nearest SI_VCO_TARGET (an
+    // integer PLL, least jitter). False for VFO0 or a VCO outside the usable range.
+    bool setFractional(uint8_t vfoIdx, bool on, uint32_t vcoHz = 0);
+    bool isFractional(uint8_t vfoIdx) const { return vfoIdx == 1 && _fracVco; }
+
+    // Write a clock plan for all outputs, false if it is not valid or a write failed. A quadrature
+    // pair gets its PLL reset when its dividers or phase offset change; nothing else is reset. VFO
+    // settings the plan can express are kept (VFO0 = CLK0/CLK1 on PLLA, VFO1 = CLK2 on PLLB, even
+    // integer dividers), the others are cleared, so update() of every VFO brings the VFO layout
+    // back. It also ends fractional mode.
+    bool apply(const si_clock_plan_t& p);
+
+    // Load a full register map (mask: bit per register present, e.g. from Si5351Map): outputs off,
+    // the registers that differ from the chip in as few transactions as possible, one reset of both
+    // PLLs, then the map's output enables. VFO settings are cleared, setFreq() and update() plan
+    // them again; drive strengths and PLL sources are taken from the map's CLKx_CTL bytes. Runs
+    // longer than the bus takes go out in pieces (Si5351Bus::maxWrite()). Returns false if a write
+    // failed: the outputs then stay off (or as they were, if even that failed); load again.
+    bool load(const uint8_t* regs, const uint8_t* mask);
+
+    // Record registers and VFO settings that were written behind the driver's back (e.g. by DMA),
+    // so the register mirror and getFreq() stay valid without another bus transfer. A noteRegs()
+    // call stands for one write transaction and counts in stats() like writeRegs().
+    void noteRegs(uint8_t reg, const uint8_t* data, uint8_t len);
+    void noteVfo(uint8_t vfoIdx, const vfo_t& v);
+
+    // Registers whose value on the chip is unknown (e.g. after an aborted DMA transfer): the mirror
+    // drops them, so the next update() that stages them sends them again
+    void forgetRegs(uint8_t reg, uint8_t len);
+
+    // Bus traffic counters, e.g. to check the cost of an operation against its budget
+#ifdef SI5351_MINIMAL
+    const si_stats_t& stats() const { static const si_stats_t none = {}; return none; }
+    void clearStats() {}
+#else
+    const si_stats_t& stats() const { return _stats; }
+    void clearStats() { _stats = si_stats_t(); }
+#endif
+
+    // Enable or disable a VFO (0 = CLK0+CLK1, 1 = CLK2), false if a write failed
+    bool enable(uint8_t vfoIdx, bool en);
+
+    // Set phase for VFO0 (CLK1 relative to CLK0)
+    void setPhase(uint8_t vfoIdx, uint8_t phase);
+
+    // Set the desired frequency in Hz (registers updated by update()), false if it cannot be reached
+    bool setFreq(uint8_t vfoIdx, uint32_t freqHz);
+
+    // Use settings planned ahead (e.g. by plan() or planDivider()) on the next update(), false if invalid
+    bool setVfo(uint8_t vfoIdx, const vfo_t& v);
+
+    // Frequency in Hz actually produced by the planned dividers of a VFO
+    uint32_t getFreq(uint8_t vfoIdx) const;
+
+    // Current VFO settings and output state, e.g. to save them
+    const vfo_t& getVfo(uint8_t vfoIdx) const { return _vfo[vfoIdx < SI5351_VFO_COUNT ? vfoIdx : 0]; }
+    bool isEnabled(uint8_t vfoIdx) const;
+
+    // Output enable register as last set by the driver (bit set = output disabled)
+    uint8_t outputs() const { return _next[SI_CLK_OE]; }
+
+    // Any register as last written or staged by the driver, e.g. to pre-build images from it
+    uint8_t reg(uint8_t r) const { return r < SI_REG_COUNT ? _next[r] : 0; }
+    // reg(r) is what the chip holds: the driver wrote it and nothing else is staged (or left over
+    // from a failed write) since
+    bool known(uint8_t r) const { return r < SI_REG_COUNT && (_known[r >> 3] & (1 << (r & 7))) && !_differs(r); }
+
+    // Drive strength of one output (CLK0..CLK2), 4 mA by default
+    void setDrive(uint8_t clkIdx, uint8_t drive);
+
+    // Per-band drive strength for a VFO's outputs, sorted by maxHz; it overrides setDrive() for
+    // those outputs, frequencies above the last entry use it too. Null removes the table.
+    void setDriveTable(uint8_t vfoIdx, const si_drive_band_t* table, uint8_t n);
+
+    // Per-band VCO target for a VFO, sorted by maxHz like the drive table; null goes back to
+    // SI_VCO_TARGET. Used by setFreq() in SI_VCO_NEAREST mode.
+    void setVcoTable(uint8_t vfoIdx, const si_vco_band_t* table, uint8_t n);
+
+    // How setFreq() picks the MultiSynth divider of a VFO. SI_VCO_SPAN keeps the current divider
+    // while the new frequency can still be reached with it (no PLL reset); when it cannot, it takes
+    // the divider that leaves the widest reset-free span on both sides of the new frequency.
+    void setVcoMode(uint8_t vfoIdx, uint8_t mode);
+
+    // VCO ranges no divider choice may land in while another divider fits, for all VFOs; null
+    // removes them. Takes effect from the next setFreq().
+    void setVcoAvoid(const si_vco_zone_t* zones, uint8_t n);
+
+    // Frequencies a VFO reaches with its current dividers, i.e. without a PLL reset; false in
+    // fractional mode or before the first setFreq()
+    bool span(uint8_t vfoIdx, uint32_t& loHz, uint32_t& hiHz) const;
+
+    // Power down the MultiSynths of disabled VFOs. Enabling such a VFO powers it up and resets its
+    // PLL (to realign the quadrature outputs) before the outputs are switched on.
+    void setPowerSave(bool on);
+
+    // Level of a VFO's outputs while disabled (SI_DIS_LOW, SI_DIS_HIGH, SI_DIS_HIZ or SI_DIS_NEVER)
+    void setDisableState(uint8_t vfoIdx, uint8_t state);
+
+    // Target frequency in Hz last accepted by setFreq()
+    uint32_t getTarget(uint8_t vfoIdx) const { return vfoIdx < SI5351_VFO_COUNT ? _vfo[vfoIdx].freq : 0; }
+
+    // Calculate and write all necessary registers for a VFO. False if a write failed: the registers
+    // that did not arrive stay staged and the PLL reset stays owed, the next update() retries them.
+    bool update(uint8_t vfoIdx);
+
+    // Publish LO-change timestamps of every update() that changes the chip (null to stop). The event
+    // of an update that resets the PLL is pushed by the pollLock() that sees lock.
+    void setEventQueue(Si5351LoQueue* q) { _events = q; }
+
+    // Band edges in Hz, ascending: band i covers [edges[i-1], edges[i]), band 0 is below edges[0].
+    // update() calls the hook when a VFO changes band up to SI_BAND_RELOCK; pollLock() reports lock.
+    void setBands(const uint32_t* edges, uint8_t n);
+    void onBandChange(si_band_hook_t hook, void* ctx = nullptr) { _bandHook = hook; _bandCtx = ctx; }
+    uint8_t band(uint32_t freqHz) const;
+
+    // PLL of a VFO is locked (reads the status register)
+    bool locked(uint8_t vfoIdx);
+
+    // Wait for the PLL of a VFO to lock, false on timeout
+    bool waitLock(uint8_t vfoIdx, uint32_t timeoutUs = SI_LOCK_TIMEOUT_US);
+
+    // Settle the lock confirmations update() owes: after a PLL reset or band change it returns without
+    // waiting, and the first pollLock() that reads lock calls the band hook with SI_BAND_LOCKED and
+    // pushes the LO event (SI_BAND_NOLOCK / SI_LO_NOLOCK once SI_LOCK_TIMEOUT_US have passed, or when
+    // a newer update() of the VFO comes first). Call it from loop(); true while one is pending, so
+    // while (vfo.pollLock()) {} waits for lock like before.
+    bool pollLock();
+
+    // Plan R, MultiSynth and PLL dividers for a target frequency, false if it cannot be reached
+    static bool plan(uint32_t xtalHz, uint32_t freqHz, vfo_t& out);
+
+    // Same with the VCO aimed at vcoHz instead of SI_VCO_TARGET
+    static bool planVco(uint32_t xtalHz, uint32_t freqHz, uint32_t vcoHz, vfo_t& out);
+
+    // Plan only the PLL for fixed R and MultiSynth dividers, false if the VCO would leave its range
+    static bool planDivider(uint32_t xtalHz, uint32_t freqHz, uint8_t ri, uint8_t msi, vfo_t& out);
+
+    // Usable VCO range for a crystal (VCO limits and PLL multiplier range), false if empty
+    static bool vcoWindow(uint32_t xtalHz, uint64_t& lo, uint64_t& hi);
+
+    // Smallest R divider for a frequency and the even MultiSynth dividers that keep the VCO in
+    // range with it, false if there are none
+    static bool dividerRange(uint32_t xtalHz, uint32_t freqHz, uint8_t& ri, uint8_t& msiLo, uint8_t& msiHi);
+
+    // Encode a PLL feedback divider (a + b/c) into its 8-byte register image (AN619 section 3.2)
+    static void encodeMSN(uint8_t* buf, uint32_t a, uint32_t b, uint32_t c);
+
+    // Encode an integer MultiSynth divider (4..126) and R divider code into its 8-byte register image
+    static void encodeMSI(uint8_t* buf, uint8_t msi, uint8_t rDivLog2);
+
+    // Same for any MultiSynth divider a + b/c (4..2048, c up to SI_MS_C_MAX)
+    static void encodeMS(uint8_t* buf, uint32_t a, uint32_t b, uint32_t c, uint8_t rDivLog2);
+
+    // MultiSynth divider a + b/c and R that take a PLL at xtal * (msna + msnb/SI_PLL_C) to freqHz,
+    // exact or the closest fraction with c up to SI_MS_C_MAX; false if no divider fits
+    static bool planFractional(uint32_t xtalHz, uint32_t msna, uint32_t msnb, uint32_t freqHz,
+                               uint8_t& ri, uint32_t& a, uint32_t& b, uint32_t& c);
+
+private:
+    uint32_t _xtal; // Crystal frequency in Hz
+    Si5351WireBus _wire;          // Default bus
+    Si5351Bus* _bus = &_wire;     // Bus used for all register traffic
+    uint32_t _probeHz = 0;        // Probe limit for begin(), 0 = no probe
+    uint32_t _busHz = 0;          // Rate chosen by probeBus()
+    vfo_t _vfo[SI5351_VFO_COUNT] = {}; // VFO configurations: 0 for CLK0/CLK1 (quadrature), 1 for CLK2
+#ifndef SI5351_MINIMAL
+    si_stats_t _stats = {}; // Bus traffic counters
+#endif
+    uint32_t _fracVco = 0;                 // VFO1 fractional mode: fixed PLLB VCO in Hz, 0 = off
+    struct { uint32_t a, b, c; } _ms2 = {}; // VFO1 MultiSynth divider in fractional mode
+    uint8_t _src[3] = {SI_CLK_INT, SI_CLK_INT, SI_CLK_INT | SI_CLK_PLLB}; // PLL and integer mode per output
+    uint8_t _drive[3] = {SI_DRIVE_4MA, SI_DRIVE_4MA, SI_DRIVE_4MA}; // Drive strength per output
+    const si_drive_band_t* _driveTable[SI5351_VFO_COUNT] = {}; // Per-band drive per VFO, optional
+    uint8_t _driveBands[SI5351_VFO_COUNT] = {};
+    const si_vco_band_t* _vcoTable[SI5351_VFO_COUNT] = {}; // Per-band VCO target per VFO, optional
+    uint8_t _vcoBands[SI5351_VFO_COUNT] = {};
+    uint8_t _vcoMode[SI5351_VFO_COUNT] = {};                // SI_VCO_NEAREST or SI_VCO_SPAN
+    const si_vco_zone_t* _vcoZones = nullptr;               // VCO ranges to avoid, optional
+    uint8_t _vcoZoneCount = 0;
+    bool _powerSave = false; // MultiSynths of disabled VFOs are powered down
+    const uint32_t* _bandEdges = nullptr; // Band table, optional
+    uint8_t _bandCount = 0;
+    uint8_t _band[SI5351_VFO_COUNT] = {}; // Band each VFO was last written in
+    uint8_t _bandKnown = 0;               // Bit per VFO: _band[] valid since the last setBands()
+    si_band_hook_t _bandHook = nullptr;
+    void* _bandCtx = nullptr;
+    Si5351LoQueue* _events = nullptr; // LO-change timestamps, optional
+    uint32_t _eventSeq = 0;
+
+    // Lock confirmation owed by the last update() of each VFO, settled by pollLock()
+    typedef struct {
+        si_lo_event_t e;  // Event to push
+        uint32_t start;   // Reset issued, the timeout runs from here
+        uint8_t from, to; // Band change to report
+        uint8_t what;     // SI_WAIT_* bits, 0 = nothing owed
+    } lock_wait_t;
+    lock_wait_t _lockWait[SI5351_VFO_COUNT] = {};
+
+    // Register image: changes are staged in _next and only the bytes differing from _reg are sent
+    uint8_t _reg[SI_REG_COUNT] = {};                  // Values last written to the chip
+    uint8_t _next[SI_REG_COUNT] = {};                 // Staged values
+    uint8_t _known[(SI_REG_COUNT + 7) / 8] = {};      // Bit set once a register was written
+    uint8_t _dirty[(SI_REG_COUNT + 7) / 8] = {};      // Bit set while a register is staged
+    uint8_t _resetDue = 0;                            // PLL resets of a failed update() or begin(), sent by the next update()
+
+    // Low-level I2C communication functions
+    bool _wr(uint8_t reg, uint8_t val); // Write a single byte to a register, false if the bus failed
+    bool _wrBulk(uint8_t reg, const uint8_t* data, uint8_t len); // Write multiple bytes to consecutive registers
+    uint8_t _rd(uint8_t reg); // Read a single byte from a register
+    bool _probe(uint32_t hz); // Write/readback rounds on the scratch registers at one rate
+
+    // Staged register image functions
+    void _stage(uint8_t reg, const uint8_t* data, uint8_t len); // Stage consecutive registers
+    void _stage(uint8_t reg, uint8_t val) { _stage(reg, &val, 1); } // Stage a single register
+    bool _differs(uint8_t reg) const; // Staged value not yet on the chip
+    bool _pending(uint8_t reg, uint8_t len) const; // Any staged value in the range not yet on the chip
+    bool _commit(); // Write staged changes in as few transactions as possible, false if a write failed
+    bool _resetPLL(uint8_t mask); // Issue a PLL reset (SI_PLL_RESET_A / SI_PLL_RESET_B)
+    bool _lockCheck(uint8_t vfoIdx, bool force); // Settle the lock confirmation a VFO owes, false while pending
+
+    // PLL and MultiSynth configuration functions
+    void _setMSN(uint8_t pllIdx, uint32_t a, uint32_t b); // Stage PLL multiplier a + b/SI_PLL_C
+    void _setMSI(uint8_t clkIdx, uint8_t msiEven, uint8_t rDivLog2); // Stage MultiSynth divider
+    uint8_t _stageVfo(uint8_t vfoIdx); // Stage all registers of a VFO, returns the PLL reset mask needed
+    uint8_t _ctl(uint8_t clkIdx, bool powerUp = false) const; // Compose a CLKx_CTL byte, powerUp overrides power save
+    void _stageCtl(uint8_t vfoIdx, bool powerUp = false); // Stage the CLKx_CTL bytes of a VFO
+
+    // Calculate parameters for a target frequency
+    bool _evaluate(uint8_t vfoIdx, uint32_t freqHz);
+    bool _planVfo(uint8_t vfoIdx, uint32_t freqHz, vfo_t& v) const; // Divider choice per setVcoMode()
+    bool _avoided(uint64_t vcoHz) const; // VCO inside a setVcoAvoid() zone
+
+    // Check that saved VFO settings hold a usable divider combination
+    static bool _valid(const vfo_t& v);
+
+    // Convert R divider value to its code (1, 2, 4, ..., 128 -> 0..7)
+    static uint8_t _rDivToCode(uint8_t r);
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "si5351_arbiter.h"
+#include "si5351.h"
+
+/*
+ * si5351_arbiter.cpp
+ *
+ * Shared I2C bus scheduler, see si5351_arbiter.h.
+ */
+
+// ============ Bus Ownership ============
+
+// One transaction at a time. Interrupts stay enabled; a handler cannot wait for the owner it may
+// have interrupted, so it only tries
+SI5351_HOT bool Si5351Arbiter::_lock() {
+#if defined(ARDUINO_ARCH_RP2040)
+    if (__get_current_exception()) return mutex_try_enter(&_mutex, nullptr);
+    mutex_enter_blocking(&_mutex);
+#endif
+    return true;
+}
+
+SI5351_HOT void Si5351Arbiter::_unlock() {
+#if defined(ARDUINO_ARCH_RP2040)
+    mutex_exit(&_mutex);
+#endif
+}
+
+// High-priority transfers waiting or running. Both cores and handlers count in and out, so the
+// count changes under a spin lock that also masks interrupts, held for the update only
+SI5351_HOT void Si5351Arbiter::_waiting(int8_t d) {
+#if defined(ARDUINO_ARCH_RP2040)
+    critical_section_enter_blocking(&_count);
+    _hiWaiting += d;
+    critical_section_exit(&_count);
+#else
+    _hiWaiting += d;
+#endif
+}
+
+void Si5351Arbiter::begin() {
+    if (_started) return; // Called by every client sharing the bus
+#if defined(ARDUINO_ARCH_RP2040)
+    mutex_init(&_mutex);
+    critical_section_init(&_count);
+#endif
+    _bus.begin();
+    _started = true;
+}
+
+// Takes effect between transactions
+void Si5351Arbiter::setClock(uint32_t hz) {
+    if (!_lock()) return;
+    _bus.setClock(hz);
+    _unlock();
+}
+
+SI5351_HOT void Si5351Arbiter::_waited(uint32_t t0) {
+    uint32_t w = micros() - t0;
+    if (w > _maxWait) _maxWait = w;
+}
+
+// ============ High Priority ============
+
+SI5351_HOT bool Si5351Arbiter::write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) {
+    uint32_t t0 = micros();
+    _waiting(1); // poll() does not start another chunk
+    if (!_lock()) {
+        _waiting(-1);
+        return false;
+    }
+    _waited(t0);
+    bool ok = _bus.write(addr, head, headLen, data, len);
+    _unlock();
+    _waiting(-1);
+    return ok;
+}
+
+SI5351_HOT bool Si5351Arbiter::read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) {
+    uint32_t t0 = micros();
+    _waiting(1);
+    if (!_lock()) {
+        _waiting(-1);
+        return false;
+    }
+    _waited(t0);
+    bool ok = _bus.read(addr, head, headLen, data, len);
+    _unlock();
+    _waiting(-1);
+    return ok;
+}
+
+// ============ Low Priority Jobs ============
+
+bool Si5351Arbiter::_chunk(si_bus_job_t* job) {
+    uint8_t size = job->chunk ? job->chunk : SI_BUS_CHUNK;
+    uint16_t n = job->len - job->offset;
+    if (n > size) n = size;
+
+    uint8_t head[2] = {job->head[0], job->head[1]};
+    if ((job->flags & SI_JOB_ADDR) && job->headLen) {
+        uint16_t a = job->headLen == 2 ? (uint16_t)(head[0] << 8 | head[1]) : head[0];
+        a += job->offset;
+        uint16_t room = size - a % size; // Up to the next page boundary
+        if (n > room) n = room;
+        if (job->headLen == 2) {
+            head[0] = a >> 8;
+            head[1] = a & 0xFF;
+        } else {
+            head[0] = a & 0xFF;
+        }
+    }
+
+    if (!_lock()) return false; // Retried like a chunk that was not acknowledged
+    bool ok = (job->flags & SI_JOB_READ)
+        ? _bus.read(job->addr, head, job->headLen, job->data + job->offset, n)
+        : _bus.write(job->addr, head, job->headLen, job->data + job->offset, n);
+    _unlock();
+    if (ok) {
+        job->offset += n;
+        _chunks++;
+    }
+    return ok;
+}
+
+void Si5351Arbiter::_finish(si_bus_job_t* job, uint8_t state) {
+    job->state = state;
+    if (job->done) job->done(job->ctx, state == SI_JOB_DONE);
+}
+
+bool Si5351Arbiter::submit(si_bus_job_t* job) {
+    if (job->state == SI_JOB_QUEUED || queued() >= SI_BUS_JOBS) return false;
+    job->offset = 0;
+    job->failing = false;
+    job->state = SI_JOB_QUEUED;
+    _jobs[_head % SI_BUS_JOBS] = job;
+    _head++;
+    return true;
+}
+
+bool Si5351Arbiter::poll(uint32_t nowUs) {
+    if (_head == _tail) return false;
+    if (_hiWaiting) return true; // The synthesizer goes first
+    si_bus_job_t* job = _jobs[_tail % SI_BUS_JOBS];
+
+    if (job->failing && (int32_t)(nowUs - job->tryUs) < SI_BUS_RETRY_US) return true;
+    if (_chunk(job)) {
+        job->failing = false;
+        if (job->offset < job->len) return true;
+        _tail++;
+        _finish(job, SI_JOB_DONE);
+    } else {
+        if (!job->failing) job->failUs = nowUs;
+        job->failing = true;
+        job->tryUs = nowUs;
+        if ((int32_t)(nowUs - job->failUs) < SI_BUS_GIVEUP_US) return true;
+        _tail++;
+        _finish(job, SI_JOB_FAILED);
+    }
+    return _head != _tail;
+}
+
+bool Si5351Arbiter::run(si_bus_job_t* job) {
+    if (job->state == SI_JOB_QUEUED) return false;
+    job->offset = 0;
+    job->state = SI_JOB_QUEUED;
+    uint32_t t0 = 0;
+    bool failing = false;
+    for (;;) {
+        if (_chunk(job)) {
+            failing = false;
+            if (job->offset >= job->len) break;
+            continue;
+        }
+        uint32_t now = micros();
+        if (!failing) t0 = now;
+        failing = true;
+        if ((int32_t)(now - t0) >= SI_BUS_GIVEUP_US) {
+            _finish(job, SI_JOB_FAILED);
+            return false;
+        }
+        delayMicroseconds(SI_BUS_RETRY_US);
+    }
+    _finish(job, SI_JOB_DONE);
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef _SI5351_ARBITER_H_
+#define _SI5351_ARBITER_H_
+/*
+ * si5351_arbiter.h
+ *
+ * Shared I2C bus scheduler. When the Si5351 shares the bus with a display or
+ * an EEPROM, a long transfer of theirs would hold a retune back for as long as
+ * it takes. Here the other devices queue their transfers as jobs, which poll()
+ * sends in bounded chunks, one transaction per call; the driver's own traffic
+ * (the arbiter is its bus, see Si5351::setBus()) is sent at once between
+ * chunks. A retune therefore waits for at most one chunk: 16 data bytes,
+ * about 0.45 ms at 400 kHz.
+ *
+ *   Si5351WireBus wire;
+ *   Si5351Arbiter bus(wire);
+ *   si5351.setBus(&bus);   // before begin()
+ *   ...
+ *   bus.submit(&oledJob);  // e.g. a display frame, sent by bus.poll(micros())
+ *
+ * A job whose chunk is not acknowledged (an EEPROM busy with its write cycle)
+ * is retried after SI_BUS_RETRY_US until SI_BUS_GIVEUP_US have passed.
+ *
+ * On RP2040 every transaction holds a mutex, which does not mask interrupts, so
+ * the driver may also be used from the other core: it then waits for the chunk
+ * in progress, and poll() leaves the bus to it as soon as that chunk is done.
+ * An interrupt handler (e.g. a hardware alarm) must not block on the mutex: a
+ * transfer from one that finds a chunk in progress fails at once, so update()
+ * returns false and the next update() sends the rest. On other cores, use the
+ * driver and poll() from the same context.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351_bus.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/mutex.h>
+#include <pico/critical_section.h>
+#endif
+
+#define SI_BUS_CHUNK      16    // Default data bytes per low-priority transaction
+#define SI_BUS_JOBS       4     // Queued low-priority jobs
+#define SI_BUS_RETRY_US   500   // Wait before resending a chunk that was not acknowledged
+#define SI_BUS_GIVEUP_US  20000 // Fail a job whose chunk stays unacknowledged this long
+
+// Job flags
+#define SI_JOB_READ       0x01  // Read into data instead of writing it
+#define SI_JOB_ADDR       0x02  // head is a big-endian memory address, advanced by each chunk;
+                                // chunks do not cross a multiple of chunk (EEPROM pages)
+
+// Job states
+#define SI_JOB_IDLE       0
+#define SI_JOB_QUEUED     1
+#define SI_JOB_DONE       2
+#define SI_JOB_FAILED     3
+
+typedef void (*si_job_done_t)(void* ctx, bool ok);
+
+// Low-priority transfer, owned by the caller and left untouched until it is done or failed.
+// Every chunk is one transaction: START, addr, head (e.g. a display control byte or an
+// EEPROM memory address), the chunk of data, STOP; reads write the head and read the chunk.
+typedef struct {
+    uint8_t addr;               // 7-bit device address
+    uint8_t flags;              // SI_JOB_READ, SI_JOB_ADDR
+    uint8_t head[2];
+    uint8_t headLen;            // 0..2
+    uint8_t chunk;              // Data bytes per transaction, 0 = SI_BUS_CHUNK
+    uint8_t* data;
+    uint16_t len;
+    si_job_done_t done;         // Optional, called from poll()
+    void* ctx;
+    volatile uint8_t state;     // SI_JOB_*
+    uint16_t offset;            // Bytes transferred so far
+    bool failing;               // Current chunk was not acknowledged
+    uint32_t failUs, tryUs;     // Its first and latest try
+} si_bus_job_t;
+
+class Si5351Arbiter : public Si5351Bus {
+public:
+    explicit Si5351Arbiter(Si5351Bus& bus)
+      : _bus(bus) {}
+
+    void begin() override;
+    void setClock(uint32_t hz) override;
+    uint16_t maxWrite() const override { return _bus.maxWrite(); }
+
+    // High-priority transfers (the driver's), sent at once or right after the chunk in progress
+    bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) override;
+    bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) override;
+
+    // Queue a low-priority job, false if the queue is full or the job is already queued
+    bool submit(si_bus_job_t* job);
+
+    // Send the next chunk of the oldest job, call it often from loop(); returns true while jobs are queued
+    bool poll(uint32_t nowUs);
+
+    // Send a job now, chunk by chunk (the driver can still get in between), false if it failed
+    bool run(si_bus_job_t* job);
+
+    uint8_t queued() const { return (uint8_t)(_head - _tail); }
+    uint32_t chunks() const { return _chunks; }   // Low-priority transactions sent
+    uint32_t maxWaitUs() const { return _maxWait; } // Longest wait of a high-priority transfer
+    void clearMaxWait() { _maxWait = 0; }
+
+private:
+    Si5351Bus& _bus;
+    si_bus_job_t* _jobs[SI_BUS_JOBS] = {};
+    uint8_t _head = 0, _tail = 0;   // Job ring, free-running indices
+    volatile uint8_t _hiWaiting = 0; // High-priority transfers waiting or running, see _waiting()
+    uint32_t _chunks = 0;
+    uint32_t _maxWait = 0;
+    bool _started = false;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    mutex_t _mutex;
+    critical_section_t _count; // Guards _hiWaiting
+#endif
+    bool _lock(); // Take the bus for one transaction, false if a handler finds it taken
+    void _unlock();
+    void _waited(uint32_t t0);
+    void _waiting(int8_t d); // Count a high-priority transfer in (1) or out (-1)
+
+    bool _chunk(si_bus_job_t* job);  // One transaction of a job, false if not acknowledged
+    void _finish(si_bus_job_t* job, uint8_t state);
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "si5351_bank.h"
+
+/*
+ * si5351_bank.cpp
+ *
+ * Flash-resident preset banks, see si5351_bank.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/dma.h>
+#endif
+
+// ============ Encoding ============
+
+// Append one frame: register address, data bytes, STOP on the last one
+static void putFrame(si_preset_t& e, uint8_t reg, const uint8_t* data, uint8_t len) {
+    e.frame[e.words++] = reg;
+    for (uint8_t i = 0; i < len; i++) e.frame[e.words++] = data[i];
+    e.frame[e.words - 1] |= SI_BANK_STOP;
+}
+
+// Same register layout as Si5351::update(): VFO0 = PLLA + MS0/MS1, VFO1 = PLLB + MS2
+bool Si5351Bank::encode(si_preset_t& out, uint32_t xtalHz, uint8_t vfoIdx, uint32_t freqHz, uint8_t phase) {
+    vfo_t v = vfo_t();
+    if (vfoIdx >= SI5351_VFO_COUNT || phase > PH090 || !Si5351::plan(xtalHz, freqHz, v)) return false; // No CLK1_CTL
+
+    out = si_preset_t();
+    out.vfo = vfoIdx;
+    out.phase = phase;
+    out.ri = v.ri;
+    out.msi = v.msi;
+    out.msna = (uint8_t)v.msna;
+    out.freq = freqHz;
+    out.msnb = v.msnb;
+
+    uint8_t img[16];
+    uint8_t rcode = 0;
+    while ((1 << rcode) < v.ri) rcode++;
+    Si5351::encodeMSN(img, v.msna, v.msnb, SI_PLL_C);
+    putFrame(out, vfoIdx == 0 ? SI_SYNTH_PLLA : SI_SYNTH_PLLB, img, 8);
+
+    Si5351::encodeMSI(img, v.msi, rcode);
+    if (vfoIdx == 0) {
+        for (uint8_t i = 0; i < 8; i++) img[8 + i] = img[i]; // CLK1 uses the same divider
+        putFrame(out, SI_SYNTH_MS0, img, 16);
+        uint8_t phoff[2] = {0, (uint8_t)(phase == PH090 ? v.msi : 0)};
+        putFrame(out, SI_CLK0_PHOFF, phoff, 2);
+    } else {
+        putFrame(out, SI_SYNTH_MS2, img, 8);
+    }
+
+    // A preset does not know the divider in use before it, so it always resets its PLL
+    uint8_t reset = vfoIdx == 0 ? SI_PLL_RESET_A : SI_PLL_RESET_B;
+    putFrame(out, SI_PLL_RESET, &reset, 1);
+    return true;
+}
+
+void Si5351Bank::print(Print& out, const si_preset_t& e) {
+    out.print("{ ");
+    out.print(e.vfo); out.print(", ");
+    out.print(e.words); out.print(", ");
+    out.print(e.phase); out.print(", ");
+    out.print(e.ri); out.print(", ");
+    out.print(e.msi); out.print(", ");
+    out.print(e.msna); out.print(", ");
+    out.print(e.freq); out.print("UL, ");
+    out.print(e.msnb); out.print("UL, { ");
+    for (uint8_t i = 0; i < e.words; i++) {
+        out.print("0x");
+        out.print(e.frame[i], HEX);
+        if (i + 1 < e.words) out.print(", ");
+    }
+    out.println(" } },");
+}
+
+// ============ Recall ============
+
+// Walk the frames of an entry: write them through the driver (no DMA), mirror them once a DMA recall
+// is confirmed, or drop them from the mirror after an abort. Written and mirrored frames count in stats().
+bool Si5351Bank::_sync(const si_preset_t& e, uint8_t how) {
+    bool ok = true;
+    uint8_t buf[SI_BANK_WORDS];
+    uint8_t i = 0;
+    while (i < e.words && i < SI_BANK_WORDS) {
+        uint8_t reg = e.frame[i++] & 0xFF;
+        uint8_t len = 0;
+        while (i < e.words) {
+            uint16_t w = e.frame[i++];
+            buf[len++] = w & 0xFF;
+            if (w & SI_BANK_STOP) break;
+        }
+        if (how == SYNC_WRITE) ok = ok && _vfo.writeRegs(reg, buf, len); // Stop at a failed frame
+        else if (how == SYNC_NOTE) _vfo.noteRegs(reg, buf, len);
+        else _vfo.forgetRegs(reg, len);
+    }
+    if (how == SYNC_FORGET) return false;
+
+    vfo_t v = vfo_t();
+    v.freq = e.freq;
+    v.phase = e.phase;
+    v.ri = e.ri;
+    v.msi = e.msi;
+    v.msna = e.msna;
+    v.msnb = e.msnb;
+    if (ok) _vfo.noteVfo(e.vfo, v);
+    return ok;
+}
+
+bool Si5351Bank::recall(uint16_t idx) {
+    if (idx >= _count) return false;
+    const si_preset_t& e = _table[idx];
+#if defined(ARDUINO_ARCH_RP2040)
+    if (busy()) return false;
+    if (_sent) wait(); // Settle the previous recall before any traffic of this one
+#endif
+
+    // Entries carry no CLK1_CTL: clear the inversion a 180°/270° setting left on CLK1 first
+    uint8_t ctl = _vfo.reg(SI_CLK1_CTL);
+    if (e.vfo == 0 && (ctl & SI_CLK_INV)) {
+        ctl &= ~SI_CLK_INV;
+        if (!_vfo.writeRegs(SI_CLK1_CTL, &ctl, 1)) return false;
+    }
+
+#if defined(ARDUINO_ARCH_RP2040)
+    if (_dma >= 0) {
+        i2c_hw_t* hw = i2c_get_hw(_i2c);
+        if (hw->tar != SI5351_ADDR) { // Target address can only change while the block is disabled
+            hw->enable = 0;
+            hw->tar = SI5351_ADDR;
+            hw->enable = 1;
+        }
+        (void)hw->clr_tx_abrt; // Clear an old abort, reading the register does it
+        dma_channel_config cfg = dma_channel_get_default_config(_dma);
+        channel_config_set_transfer_data_size(&cfg, DMA_SIZE_16);
+        channel_config_set_read_increment(&cfg, true);
+        channel_config_set_write_increment(&cfg, false);
+        channel_config_set_dreq(&cfg, i2c_get_dreq(_i2c, true));
+        dma_channel_configure(_dma, &cfg, &hw->data_cmd, e.frame, e.words, true);
+        _sent = &e; // The mirror follows at wait()
+        return true;
+    }
+#endif
+
+    return _sync(e, SYNC_WRITE);
+}
+
+#if defined(ARDUINO_ARCH_RP2040)
+bool Si5351Bank::beginDma(i2c_inst_t* i2c) {
+    int ch = dma_claim_unused_channel(false);
+    if (ch < 0) return false;
+    _i2c = i2c;
+    _dma = ch;
+    _guard.bank = this;
+    _guard.down = _vfo.bus();
+    _vfo.setBus(&_guard);
+    return true;
+}
+
+bool Si5351Bank::busy() const {
+    return _dma >= 0 && dma_channel_is_busy(_dma);
+}
+
+// On a missing ACK the controller flushes its FIFO and holds it, so the DMA would stall
+bool Si5351Bank::_drain() {
+    if (_dma < 0) return true;
+    i2c_hw_t* hw = i2c_get_hw(_i2c);
+    while (dma_channel_is_busy(_dma)) {
+        if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+            dma_channel_abort(_dma);
+            (void)hw->clr_tx_abrt;
+            return false;
+        }
+    }
+    while (hw->txflr || (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS)) { // FIFO still draining
+        if (hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+            (void)hw->clr_tx_abrt;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Si5351Bank::wait() {
+    bool ok = _drain();
+    if (_sent) _sync(*_sent, ok ? SYNC_NOTE : SYNC_FORGET);
+    _sent = nullptr;
+    return ok;
+}
+
+// Driver traffic may already have staged other values for these registers, so an unconfirmed
+// recall is not mirrored here, only forgotten
+void Si5351Bank::_settle() {
+    _drain();
+    if (_sent) _sync(*_sent, SYNC_FORGET);
+    _sent = nullptr;
+}
+
+bool Si5351Bank::Guard::write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) {
+    bank->_settle();
+    return down->write(addr, head, headLen, data, len);
+}
+
+bool Si5351Bank::Guard::read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) {
+    bank->_settle();
+    return down->read(addr, head, headLen, data, len);
+}
+#endif
@@ -0,0 +1,119 @@
+#ifndef _SI5351_BANK_H_
+#define _SI5351_BANK_H_
+/*
+ * si5351_bank.h
+ *
+ * Read-only preset banks for large channel tables. Every entry already holds the
+ * I2C frames that tune one VFO, as RP2040 IC_DATA_CMD words, so the table can stay
+ * in XIP flash (a const array) and a recall points the I2C TX DMA straight at it:
+ * no encoding and no copy to RAM per preset.
+ *
+ * Entry frames (each ends with SI_BANK_STOP, the controller starts the next one by itself):
+ *   VFO0: PLLA(26) 8 bytes | MS0+MS1(42) 16 bytes | PHOFF0/1(165) 2 bytes | PLL_RESET A
+ *   VFO1: PLLB(34) 8 bytes | MS2(58) 8 bytes | PLL_RESET B
+ * CLKx_CTL is not part of an entry, it stays as configured by the driver (integer mode,
+ * PLL source, drive). 180° and 270° need CLK1 inverted in CLK1_CTL, so encode() only
+ * takes PH000 and PH090; tune those phases with the driver instead. A VFO0 recall after
+ * one of them (the driver starts at 270°) first clears the inversion with one write.
+ *
+ * A recall counts in the driver's stats() like the same writes through the bus, the
+ * DMA path included: 4 transactions (VFO1: 3) and one PLL reset.
+ *
+ * Build the table with encode(), offline or once at startup, and print() it as C
+ * initializers to paste into a const array. Outside RP2040 (or before beginDma())
+ * recall() replays the same frames through the driver.
+ *
+ * With DMA the driver mirror follows a recall only once wait() has seen it complete;
+ * after an abort its registers are marked unknown, so the next update() rewrites them.
+ * beginDma() puts a guard in front of the driver's bus: driver traffic during a
+ * recall waits for the DMA to finish, and if wait() was not called yet the entry's
+ * registers are marked unknown as well.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/i2c.h>
+#endif
+
+#define SI_BANK_WORDS   32     // IC_DATA_CMD words per entry
+#define SI_BANK_STOP    0x0200 // IC_DATA_CMD STOP bit: end the I2C transaction after this byte
+
+// One preset, 80 bytes
+typedef struct {
+    uint8_t  vfo;    // Driver VFO index
+    uint8_t  words;  // Used words of frame[]
+    uint8_t  phase;  // VFO state after recall, for the driver mirror
+    uint8_t  ri;
+    uint8_t  msi;
+    uint8_t  msna;
+    uint32_t freq;
+    uint32_t msnb;
+    uint16_t frame[SI_BANK_WORDS]; // Register address + data bytes per frame, SI_BANK_STOP on the last
+} si_preset_t;
+
+class Si5351Bank {
+public:
+    Si5351Bank(Si5351& vfo, const si_preset_t* table, uint16_t count)
+      : _vfo(vfo), _table(table), _count(count) {}
+
+    uint16_t count() const { return _count; }
+    const si_preset_t& entry(uint16_t idx) const { return _table[idx]; }
+
+    // Tune to a preset and update the driver mirror (with DMA: at wait()), false if idx is out of
+    // range, a previous DMA recall is still running or (without DMA) a write failed
+    bool recall(uint16_t idx);
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Claim a DMA channel for recall() on an I2C block already set up by Wire
+    bool beginDma(i2c_inst_t* i2c = i2c0);
+
+    // DMA recall still sending
+    bool busy() const;
+
+    // Wait until the recall has been sent and update the driver mirror, false if the chip did
+    // not acknowledge
+    bool wait();
+#endif
+
+    // Encode a preset for a crystal, false if the frequency cannot be reached or the phase
+    // needs CLK1 inverted (PH180, PH270)
+    static bool encode(si_preset_t& out, uint32_t xtalHz, uint8_t vfoIdx, uint32_t freqHz, uint8_t phase = PH000);
+
+    // Print an entry as a C initializer line, for building a const table
+    static void print(Print& out, const si_preset_t& e);
+
+private:
+    Si5351& _vfo;
+    const si_preset_t* _table;
+    uint16_t _count;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Driver bus while DMA is in use: every transfer first waits for the recall in progress
+    class Guard : public Si5351Bus {
+    public:
+        Si5351Bank* bank = nullptr;
+        Si5351Bus* down = nullptr;
+        void begin() override { down->begin(); }
+        void setClock(uint32_t hz) override { bank->_settle(); down->setClock(hz); }
+        uint16_t maxWrite() const override { return down->maxWrite(); }
+        bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) override;
+        bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) override;
+    };
+
+    i2c_inst_t* _i2c = nullptr;
+    int _dma = -1;                       // DMA channel, -1 until beginDma()
+    const si_preset_t* _sent = nullptr;  // DMA recall the mirror does not follow yet
+    Guard _guard;
+
+    bool _drain();  // Wait for the DMA and the I2C FIFO, false on an abort
+    void _settle(); // Before driver traffic: finish the DMA, registers of an unconfirmed recall unknown
+#endif
+
+    enum { SYNC_WRITE, SYNC_NOTE, SYNC_FORGET };
+    bool _sync(const si_preset_t& e, uint8_t how); // Write, mirror or forget the entry frames
+};
+
+#endif
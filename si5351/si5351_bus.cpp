@@ -0,0 +1,27 @@
+#include "si5351_bus.h"
+#include "si5351.h"
+
+/*
+ * si5351_bus.cpp
+ *
+ * Arduino Wire bus backend, see si5351_bus.h.
+ */
+
+SI5351_HOT bool Si5351WireBus::write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) {
+    _wire.beginTransmission(addr);
+    for (uint8_t i = 0; i < headLen; i++) _wire.write(head[i]);
+    for (uint16_t i = 0; i < len; i++) _wire.write(data[i]);
+    return _wire.endTransmission() == 0;
+}
+
+SI5351_HOT bool Si5351WireBus::read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) {
+    _wire.beginTransmission(addr);
+    for (uint8_t i = 0; i < headLen; i++) _wire.write(head[i]);
+    if (_wire.endTransmission(false) != 0) return false; // Keep the bus for the repeated START
+    _wire.requestFrom(addr, (uint8_t)len);
+    for (uint16_t i = 0; i < len; i++) {
+        if (!_wire.available()) return false;
+        data[i] = _wire.read();
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef _SI5351_BUS_H_
+#define _SI5351_BUS_H_
+/*
+ * si5351_bus.h
+ *
+ * I2C bus interface used by the driver for all register traffic. The default
+ * is Si5351WireBus on the Arduino Wire object; other backends (a bus arbiter
+ * shared with other devices, a PIO master) implement the same two calls and
+ * are handed to Si5351::setBus() before begin().
+ *
+ * A transfer is one transaction: START, address, the head bytes (register
+ * address or command), then the data, STOP. A read writes the head and reads
+ * after a repeated START. maxWrite() caps the length of a write: the driver
+ * splits longer runs of registers into several transactions.
+ *
+ */
+
+#include <Arduino.h>
+#include <Wire.h>
+
+// Longest write through Wire, head included: the core's transmit buffer, which
+// silently drops the excess (32 bytes on AVR)
+#ifndef SI_WIRE_MAX_BYTES
+#ifdef BUFFER_LENGTH
+#define SI_WIRE_MAX_BYTES BUFFER_LENGTH
+#else
+#define SI_WIRE_MAX_BYTES 32
+#endif
+#endif
+
+class Si5351Bus {
+public:
+    virtual ~Si5351Bus() {}
+
+    // Bring the bus up (called by Si5351::begin())
+    virtual void begin() {}
+
+    // SCL rate in Hz, ignored by backends with a fixed rate
+    virtual void setClock(uint32_t hz) { (void)hz; }
+
+    // Longest write the backend takes in one transaction, head included
+    virtual uint16_t maxWrite() const { return 0xFFFF; }
+
+    // Write head then data in one transaction, false if not acknowledged
+    virtual bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) = 0;
+
+    // Write head, then read len bytes after a repeated START, false on error
+    virtual bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) = 0;
+};
+
+// Arduino Wire backend
+class Si5351WireBus : public Si5351Bus {
+public:
+    explicit Si5351WireBus(TwoWire& wire = Wire)
+      : _wire(wire) {}
+
+    void begin() override { _wire.begin(); }
+    void setClock(uint32_t hz) override { _wire.setClock(hz); }
+    uint16_t maxWrite() const override { return SI_WIRE_MAX_BYTES; }
+    bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) override;
+    bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) override;
+
+private:
+    TwoWire& _wire;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "si5351_cat.h"
+
+/*
+ * si5351_cat.cpp
+ *
+ * Kenwood TS-2000 compatible CAT subset, see si5351_cat.h.
+ */
+
+// Collect characters up to ';', execute, then write each changed VFO once
+void Si5351Cat::poll() {
+    while (_port.available() > 0) {
+        char c = (char)_port.read();
+        if (c == ';') {
+            if (_skip) {
+                _skip = false; // End of the overlong command, reject it once
+                _answer("?;");
+            } else {
+                _cmd[_len] = '\0';
+                _execute();
+            }
+            _len = 0;
+        } else if (_skip || c == '\r' || c == '\n' || c == ' ') {
+            // Rest of an overlong command, or line ends some programs put between commands
+        } else if (_len < SI_CAT_MAX - 1) {
+            _cmd[_len++] = (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+        } else {
+            _len = 0; // Overlong garbage: drop it up to its ';', so its tail is not run as a command
+            _skip = true;
+        }
+    }
+
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT && i < 2; i++) {
+        if (!(_pending & (1 << i))) continue;
+        _pending &= ~(1 << i);
+        _vfo.update(i);
+    }
+}
+
+void Si5351Cat::_execute() {
+    if (_len < 2) { _answer("?;"); return; }
+    char a = _cmd[0], b = _cmd[1];
+    const char* arg = &_cmd[2];
+    uint8_t argLen = _len - 2;
+
+    if (a == 'F' && (b == 'A' || b == 'B')) {
+        uint8_t v = (b == 'A') ? 0 : 1;
+        if (argLen == 0) {
+            if (!_freq[v]) _freq[v] = _vfo.getTarget(v); // First query, take the driver's default
+            _answerFreq(b, v);
+            return;
+        }
+        uint32_t f;
+        if (!_parseFreq(arg, argLen, f)) { _answer("?;"); return; }
+        if (v < SI5351_VFO_COUNT) {
+            if (!_vfo.setFreq(v, f)) { _answer("?;"); return; } // Out of range
+            _pending |= 1 << v;
+        }
+        _freq[v] = f;
+        return; // Set commands have no answer
+    }
+
+    if (a == 'I' && b == 'F' && argLen == 0) { _answerIF(); return; }
+
+    if (a == 'T' && b == 'X') {
+        _tx = true;
+        _vfo.enable(_txVfo, true);
+        return;
+    }
+    if (a == 'R' && b == 'X') {
+        _tx = false;
+        _vfo.enable(_txVfo, false);
+        return;
+    }
+
+    if (a == 'M' && b == 'D') {
+        if (argLen == 0) {
+            _answer("MD");
+            _port.write('0' + _mode);
+            _port.write(';');
+        } else if (argLen == 1 && arg[0] >= '1' && arg[0] <= '9') {
+            _mode = arg[0] - '0';
+        } else {
+            _answer("?;");
+        }
+        return;
+    }
+
+    if (argLen == 0) {
+        if (a == 'I' && b == 'D') { _answer("ID019;"); return; } // TS-2000
+        if (a == 'A' && b == 'I') { _answer("AI0;"); return; }   // No auto information
+        if (a == 'P' && b == 'S') { _answer("PS1;"); return; }   // Powered on
+        if (a == 'F' && b == 'R') { _answer("FR0;"); return; }   // Receive on VFO A
+        if (a == 'F' && b == 'T') { _answer("FT0;"); return; }   // Transmit on VFO A
+    } else if ((a == 'A' && b == 'I') || (a == 'F' && (b == 'R' || b == 'T'))) {
+        return; // Accepted and ignored, the answers above stay fixed
+    }
+
+    _answer("?;");
+}
+
+void Si5351Cat::_answerFreq(char vfoChar, uint8_t vfoIdx) {
+    _port.write('F');
+    _port.write(vfoChar);
+    _digits(_freq[vfoIdx], 11);
+    _port.write(';');
+}
+
+// IF: freq(11) step(5) rit(5) rit xit bank(1) mem(2) tx mode fr scan split tone toneNr(2) 0
+void Si5351Cat::_answerIF() {
+    if (!_freq[0]) _freq[0] = _vfo.getTarget(0);
+    _answer("IF");
+    _digits(_freq[0], 11);
+    _answer("     +000000000");   // Step, RIT/XIT offset, RIT off, XIT off, bank, memory channel
+    _port.write(_tx ? '1' : '0');
+    _port.write('0' + _mode);
+    _answer("0000000;");          // VFO A, no scan, no split, no tone, tone number, padding
+}
+
+void Si5351Cat::_answer(const char* s) {
+    _port.write((const uint8_t*)s, strlen(s));
+}
+
+void Si5351Cat::_digits(uint32_t v, uint8_t n) {
+    char buf[11];
+    for (int8_t i = n - 1; i >= 0; i--) {
+        buf[i] = '0' + v % 10;
+        v /= 10;
+    }
+    _port.write((const uint8_t*)buf, n);
+}
+
+bool Si5351Cat::_parseFreq(const char* p, uint8_t n, uint32_t& out) {
+    if (n == 0 || n > 11) return false;
+    uint64_t v = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        v = v * 10 + (uint8_t)(p[i] - '0');
+    }
+    if (v > 0xFFFFFFFFULL) return false;
+    out = (uint32_t)v;
+    return true;
+}
@@ -0,0 +1,60 @@
+#ifndef _SI5351_CAT_H_
+#define _SI5351_CAT_H_
+/*
+ * si5351_cat.h
+ *
+ * Kenwood TS-2000 compatible CAT subset for the Si5351 driver, so logging and
+ * digital-mode software (WSJT-X, fldigi via hamlib) can tune it directly.
+ *
+ * FA/FB    set or read VFO A/B frequency (VFO A = driver VFO0, VFO B = driver VFO1)
+ * IF       read transceiver status
+ * TX/RX    key/unkey: enable/disable the TX VFO output
+ * MD       set or read mode (stored only)
+ * ID AI PS FR FT  answered with fixed values, enough for hamlib's TS-2000 backend
+ *
+ * Commands are parsed in a fixed buffer without heap allocation; a command
+ * longer than SI_CAT_MAX is dropped up to its ';' and answered "?;". Queries are
+ * answered from cached state, never from the chip, and frequency changes are
+ * written once per poll() however many arrived.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_CAT_MAX  40 // Longest accepted command, including the terminating ';'
+
+class Si5351Cat {
+public:
+    // txVfo is the driver VFO that TX; enables and RX; disables
+    Si5351Cat(Si5351& vfo, Stream& port, uint8_t txVfo = 1)
+      : _vfo(vfo), _port(port), _txVfo(txVfo) {}
+
+    // Receive and answer commands, call it from loop()
+    void poll();
+
+    bool transmitting() const { return _tx; } // State set by TX; / RX;
+    uint8_t mode() const { return _mode; }    // Mode set by MD (1=LSB 2=USB 3=CW 4=FM 5=AM 6=FSK 7=CW-R 9=FSK-R)
+
+private:
+    Si5351& _vfo;
+    Stream& _port;
+    uint8_t _txVfo;
+
+    char _cmd[SI_CAT_MAX]; // Command being received
+    uint8_t _len = 0;      // Characters in _cmd
+    bool _skip = false;    // Dropping an overlong command up to its ';'
+    bool _tx = false;
+    uint8_t _mode = 2;     // USB
+    uint8_t _pending = 0;  // Bit per VFO with a frequency not yet written
+    uint32_t _freq[2] = {}; // Requested VFO A/B frequencies, VFO B is kept here even without VFO1
+
+    void _execute(); // Run the command in _cmd
+    void _answerFreq(char vfoChar, uint8_t vfoIdx); // "FA00007074000;"
+    void _answerIF(); // Transceiver status
+    void _answer(const char* s); // Send a fixed answer
+    void _digits(uint32_t v, uint8_t n); // Send v as n decimal digits with leading zeros
+    static bool _parseFreq(const char* p, uint8_t n, uint32_t& out); // n decimal digits
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "si5351_clocks.h"
+
+/*
+ * si5351_clocks.cpp
+ *
+ * PLL allocation planner for three outputs, see si5351_clocks.h.
+ */
+
+// Plan costs, in the order of how much they disturb the outputs
+#define COST_RESET   64     // PLL reset
+#define COST_MOVED   16     // Per output whose target did not change, hit by a PLL change or reset
+#define COST_PLL     8      // PLL multiplier change
+#define COST_SWITCH  4      // Output moved to the other PLL
+#define COST_FRAC    2      // Output in fractional mode (more jitter than an even integer divider)
+#define COST_MS      1      // MultiSynth block rewritten
+#define COST_NONE    0xFFFF // Not possible
+
+// ============ Dividers ============
+
+// MultiSynth divider for an output from the VCO of its PLL
+bool Si5351Clocks::_fractional(uint8_t k, uint8_t pll, si_clock_plan_t& p) const {
+    uint8_t ri;
+    uint32_t a, b, c;
+    if (!Si5351::planFractional(_vfo.getXtal(), p.msna[pll], p.msnb[pll], p.freq[k], ri, a, b, c)) return false;
+    p.pll[k] = pll;
+    p.ri[k] = ri;
+    p.msa[k] = a;
+    p.msb[k] = b;
+    p.msc[k] = c;
+    return true;
+}
+
+bool Si5351Clocks::_sameMs(uint8_t k, const si_clock_plan_t& p) const {
+    return _have && _cur.freq[k] && _cur.pll[k] == p.pll[k] && _cur.ri[k] == p.ri[k] &&
+           _cur.msa[k] == p.msa[k] && _cur.msb[k] == p.msb[k] && _cur.msc[k] == p.msc[k];
+}
+
+// ============ Planner ============
+
+uint16_t Si5351Clocks::_pll(uint8_t pll, uint8_t mask, bool keep, si_clock_plan_t& p, uint8_t& changes,
+                            uint8_t& resets) const {
+    changes = resets = 0;
+    if (!mask) { // Unused, the multiplier stays as it is
+        p.msna[pll] = _have ? _cur.msna[pll] : 0;
+        p.msnb[pll] = _have ? _cur.msnb[pll] : 0;
+        return 0;
+    }
+    uint32_t xtal = _vfo.getXtal();
+    bool quad = p.phase != SI_PLAN_FREE && (mask & 1);
+
+    if (keep) {
+        if (!_have || !_cur.msna[pll]) return COST_NONE;
+        p.msna[pll] = _cur.msna[pll];
+        p.msnb[pll] = _cur.msnb[pll];
+        for (uint8_t k = 0; k < 3; k++) {
+            if (!(mask & (1 << k))) continue;
+            if (_cur.freq[k] == p.freq[k] && _cur.pll[k] == pll) { // Unchanged
+                p.pll[k] = pll;
+                p.ri[k] = _cur.ri[k];
+                p.msa[k] = _cur.msa[k];
+                p.msb[k] = _cur.msb[k];
+                p.msc[k] = _cur.msc[k];
+            } else if (quad && k < 2) {
+                return COST_NONE; // A quadrature pair needs its own even integer divider
+            } else if (!_fractional(k, pll, p)) {
+                return COST_NONE;
+            }
+        }
+    } else {
+        // Lead output: the quadrature pair, else the highest frequency
+        uint8_t lead = 0xFF;
+        for (uint8_t k = 0; k < 3; k++) {
+            if ((mask & (1 << k)) && (lead == 0xFF || p.freq[k] > p.freq[lead])) lead = k;
+        }
+        if (quad) lead = 0;
+
+        // Even integer divider, the current one if it still fits (no MultiSynth change)
+        vfo_t v;
+        bool sticky = _have && _cur.freq[lead] && _cur.msb[lead] == 0 && !(_cur.msa[lead] & 1) && _cur.msa[lead] <= 126 &&
+                      Si5351::planDivider(xtal, p.freq[lead], _cur.ri[lead], (uint8_t)_cur.msa[lead], v);
+        if (!sticky && !Si5351::plan(xtal, p.freq[lead], v)) return COST_NONE;
+        p.msna[pll] = v.msna;
+        p.msnb[pll] = v.msnb;
+        for (uint8_t k = 0; k < 3; k++) {
+            if (!(mask & (1 << k))) continue;
+            if (k == lead || (quad && k == 1)) {
+                p.pll[k] = pll;
+                p.ri[k] = v.ri;
+                p.msa[k] = v.msi;
+                p.msb[k] = 0;
+                p.msc[k] = 1;
+            } else if (!_fractional(k, pll, p)) {
+                return COST_NONE;
+            }
+        }
+    }
+
+    uint16_t cost = 0;
+    bool changed = !_have || p.msna[pll] != _cur.msna[pll] || p.msnb[pll] != _cur.msnb[pll];
+    if (changed) {
+        if (_have) cost += COST_PLL; // A first plan writes everything anyway
+        changes = 1;
+    }
+    bool reset = quad && (!_have || !_sameMs(0, p) || _cur.phase == SI_PLAN_FREE ||
+                          (_cur.phase & 1) != (p.phase & 1)); // New divider or phase offset (90°/270°)
+    if (reset) {
+        cost += COST_RESET;
+        resets = 1;
+    }
+    for (uint8_t k = 0; k < 3; k++) {
+        if (!(mask & (1 << k))) continue;
+        if (!_sameMs(k, p)) cost += COST_MS;
+        if (p.msb[k]) cost += COST_FRAC;
+        if (_have && _cur.freq[k] && _cur.pll[k] != pll) cost += COST_SWITCH;
+        bool steady = _have && _cur.freq[k] == p.freq[k];
+        if (steady && (changed || (reset && !(quad && k < 2)))) cost += COST_MOVED;
+    }
+    return cost;
+}
+
+// Every output-to-PLL assignment, each PLL kept or retuned; outputs that are off sit on PLLA. The
+// VFO layout (CLK2 on PLLB) comes first, so it wins a tie.
+bool Si5351Clocks::plan(const uint32_t freq[3], uint8_t phase, si_clock_plan_t& out) {
+    bool quad = phase != SI_PLAN_FREE;
+    if (quad && (phase > PH270 || !freq[0])) return false;
+    uint16_t bestCost = COST_NONE;
+    uint8_t bestChanges = 0, bestResets = 0;
+
+    for (uint8_t i = 0; i < 8; i++) {
+        uint8_t assign = i ^ 4; // Bit k: output k on PLLB
+        si_clock_plan_t p = {};
+        p.phase = phase;
+        bool skip = false;
+        for (uint8_t k = 0; k < 3; k++) {
+            p.freq[k] = (quad && k == 1) ? freq[0] : freq[k];
+            if (!p.freq[k] && (assign & (1 << k))) skip = true;
+        }
+        if (skip || (quad && ((assign ^ (assign >> 1)) & 1))) continue; // The pair shares its PLL
+
+        uint16_t total = 0;
+        uint8_t changes = 0, resets = 0;
+        for (uint8_t pll = 0; pll < 2 && total < COST_NONE; pll++) {
+            uint8_t mask = 0;
+            for (uint8_t k = 0; k < 3; k++) {
+                if (p.freq[k] && ((assign >> k) & 1) == pll) mask |= 1 << k;
+            }
+            si_clock_plan_t kept = p, tuned = p;
+            uint8_t ck, rk, ct, rt;
+            uint16_t costKeep = _pll(pll, mask, true, kept, ck, rk);
+            uint16_t costTune = _pll(pll, mask, false, tuned, ct, rt);
+            if (costKeep == COST_NONE && costTune == COST_NONE) {
+                total = COST_NONE;
+            } else if (costKeep <= costTune) {
+                p = kept;
+                total += costKeep;
+                changes += ck;
+                resets += rk;
+            } else {
+                p = tuned;
+                total += costTune;
+                changes += ct;
+                resets += rt;
+            }
+        }
+        if (total < bestCost) {
+            bestCost = total;
+            bestChanges = changes;
+            bestResets = resets;
+            out = p;
+        }
+    }
+    if (bestCost == COST_NONE) return false;
+    _changes = bestChanges;
+    _resets = bestResets;
+    return true;
+}
+
+bool Si5351Clocks::set(const uint32_t freq[3], uint8_t phase) {
+    si_clock_plan_t p;
+    if (!plan(freq, phase, p) || !_vfo.apply(p)) return false;
+    _cur = p;
+    _have = true;
+    return true;
+}
+
+// xtal * (msna + msnb/c) / ((msa + msb/msc) * R), the VCO kept in mHz so it all fits 64 bits
+uint32_t Si5351Clocks::freqOf(uint32_t xtalHz, const si_clock_plan_t& p, uint8_t clkIdx) {
+    if (clkIdx > 2 || !p.freq[clkIdx] || !p.msc[clkIdx]) return 0;
+    uint8_t pll = p.pll[clkIdx];
+    uint64_t vcoMilli = (uint64_t)xtalHz * ((uint64_t)p.msna[pll] * SI_PLL_C + p.msnb[pll]) / (SI_PLL_C / 1000);
+    uint64_t den = ((uint64_t)p.msa[clkIdx] * p.msc[clkIdx] + p.msb[clkIdx]) * p.ri[clkIdx];
+    return (uint32_t)((vcoMilli * p.msc[clkIdx] / den + 500) / 1000);
+}
@@ -0,0 +1,73 @@
+#ifndef _SI5351_CLOCKS_H_
+#define _SI5351_CLOCKS_H_
+/*
+ * si5351_clocks.h
+ *
+ * PLL allocation planner for three independent outputs. The VFO layout pins
+ * CLK0/CLK1 to PLLA and CLK2 to PLLB, all with even integer dividers; here any
+ * output can use either PLL, and outputs sharing a PLL use fractional
+ * MultiSynth dividers. For each set of targets the planner tries every output
+ * to PLL assignment, and for each PLL either keeps its current multiplier or
+ * retunes it for a lead output (the quadrature pair, or the highest
+ * frequency) with an even integer divider, the others dividing fractionally.
+ * The cheapest plan wins, against the plan currently on the chip:
+ *
+ *   PLL reset (quadrature pair with a new divider or phase offset)  most
+ *   PLL multiplier change that moves outputs whose target did not change
+ *   PLL multiplier change
+ *   output moved to the other PLL, output in fractional mode
+ *   rewritten MultiSynth block                                       least
+ *
+ * So an output that changes alone is normally retuned by its MultiSynth only,
+ * or by a PLL it does not share, and the other outputs are left alone.
+ *
+ *   Si5351Clocks clocks(vfo);
+ *   uint32_t f[3] = {7074000, 7074000, 48000000};
+ *   clocks.set(f, PH090);    // CLK0/CLK1 in quadrature, CLK2 free
+ *
+ * Frequencies are exact up to the PLL numerator step for a lead output and
+ * the 20-bit MultiSynth denominator for the others (well under 1 Hz).
+ * Fractional dividers run from 8 to 2048, so outputs above ~112 MHz need a PLL
+ * of their own.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+class Si5351Clocks {
+public:
+    explicit Si5351Clocks(Si5351& vfo)
+      : _vfo(vfo) {}
+
+    // Plan targets (0 = output off) against the current plan, false if one cannot be reached.
+    // With a phase (PH000..PH270) CLK1 follows CLK0 in quadrature and freq[1] is ignored.
+    bool plan(const uint32_t freq[3], uint8_t phase, si_clock_plan_t& out);
+
+    // Plan and write it; the plan becomes the current one
+    bool set(const uint32_t freq[3], uint8_t phase = SI_PLAN_FREE);
+
+    // Forget the current plan, e.g. after the VFO calls wrote the chip
+    void reset() { _have = false; }
+
+    const si_clock_plan_t& current() const { return _cur; }
+    uint8_t changes() const { return _changes; } // PLL multipliers changed by the last plan
+    uint8_t resets() const { return _resets; }   // PLL resets needed by the last plan
+
+    // Frequency an output of a plan produces, in Hz
+    static uint32_t freqOf(uint32_t xtalHz, const si_clock_plan_t& p, uint8_t clkIdx);
+
+private:
+    Si5351& _vfo;
+    si_clock_plan_t _cur = {};
+    bool _have = false;
+    uint8_t _changes = 0, _resets = 0;
+
+    // Plan one PLL for the outputs in mask, keeping or retuning its multiplier; returns the cost,
+    // or 0xFFFF if not possible
+    uint16_t _pll(uint8_t pll, uint8_t mask, bool keep, si_clock_plan_t& p, uint8_t& changes, uint8_t& resets) const;
+    bool _fractional(uint8_t k, uint8_t pll, si_clock_plan_t& p) const; // MultiSynth of an output from its PLL
+    bool _sameMs(uint8_t k, const si_clock_plan_t& p) const;            // Output unchanged from the current plan
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "si5351_cw.h"
+
+/*
+ * si5351_cw.cpp
+ *
+ * CW keying engine, see si5351_cw.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/time.h>
+#endif
+
+// Morse patterns: elements LSB first (0 = dit, 1 = dah) under a leading 1 sentinel
+static const uint8_t morseAlpha[26] = {
+    0x06, 0x11, 0x15, 0x09, 0x02, 0x14, 0x0B, 0x10, 0x04, 0x1E, 0x0D, 0x12, 0x07, // A-M
+    0x05, 0x0F, 0x16, 0x1B, 0x0A, 0x08, 0x03, 0x0C, 0x18, 0x0E, 0x19, 0x1D, 0x13  // N-Z
+};
+static const uint8_t morseDigit[10] = {
+    0x3F, 0x3E, 0x3C, 0x38, 0x30, 0x20, 0x21, 0x23, 0x27, 0x2F // 0-9
+};
+
+uint8_t Si5351Cw::_encode(char c) {
+    if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+    if (c >= 'A' && c <= 'Z') return morseAlpha[c - 'A'];
+    if (c >= '0' && c <= '9') return morseDigit[c - '0'];
+    switch (c) {
+        case '.': return 0x6A;
+        case ',': return 0x73;
+        case '?': return 0x4C;
+        case '/': return 0x29;
+        case '=': return 0x31;
+        case '-': return 0x61;
+        default:  return 0;
+    }
+}
+
+// ============ Setup and Inputs ============
+
+void Si5351Cw::begin(uint8_t wpm, uint8_t offState) {
+    setWpm(wpm);
+    _vfo.setDisableState(_idx, offState);
+    _write(false);
+}
+
+// PARIS: 50 dits per word
+void Si5351Cw::setWpm(uint8_t wpm) {
+    if (wpm == 0) wpm = 1;
+    _dit = 1200000UL / wpm;
+}
+
+// Only the keyed bits change, the other outputs keep the state the driver last set
+SI5351_HOT void Si5351Cw::_write(bool down) {
+    uint8_t oe = _vfo.outputs();
+    oe = down ? (oe & ~_mask) : (oe | _mask);
+    _vfo.writeRegs(SI_CLK_OE, &oe, 1);
+    _keyed = down;
+}
+
+void Si5351Cw::key(bool down) {
+    if (down != _keyed) _write(down);
+}
+
+// A press is remembered until its element starts, so short taps during an element are not lost
+void Si5351Cw::paddles(bool dit, bool dah) {
+    if (dit && !_ditIn) _ditMem = true;
+    if (dah && !_dahIn) _dahMem = true;
+    _ditIn = dit;
+    _dahIn = dah;
+    if (dit || dah) _kick();
+}
+
+bool Si5351Cw::send(const char* text) {
+    bool ok = true;
+    for (; *text; text++) {
+        uint8_t next = (_head + 1) % SI_CW_QUEUE;
+        if (next == _tail) { ok = false; break; } // Full
+        _queue[_head] = *text;
+        _head = next;
+    }
+    _kick();
+    return ok;
+}
+
+// The element being sent still finishes, so the key always comes up
+void Si5351Cw::clear() {
+    _tail = _head;
+    _char = 0;
+    _ditMem = _dahMem = false;
+}
+
+// ============ Element State Machine ============
+
+// Iambic: squeezing both paddles alternates, starting opposite to the last element
+int8_t Si5351Cw::_paddleElement() {
+    bool dit = _ditIn || _ditMem;
+    bool dah = _dahIn || _dahMem;
+    int8_t el;
+    if (dit && dah) el = _last ? 0 : 1;
+    else if (dit) el = 0;
+    else if (dah) el = 1;
+    else return -1;
+
+    if (el) _dahMem = false;
+    else _ditMem = false;
+    _last = el;
+    return el;
+}
+
+// Paddles take precedence over queued text, which resumes where it was interrupted
+SI5351_HOT uint32_t Si5351Cw::step() {
+    if (_state == MARK) { // End of a mark: key up for the element space
+        _write(false);
+        _state = SPACE;
+        return _dit;
+    }
+
+    int8_t el = _paddleElement();
+    if (el < 0) {
+        if (_char == 1) { // Character done: 2 more dits make the character space
+            _char = 0;
+            _state = SPACE;
+            return 2 * _dit;
+        }
+        while (_char == 0 && _tail != _head) {
+            char c = _queue[_tail];
+            _tail = (_tail + 1) % SI_CW_QUEUE;
+            if (c == ' ') { // 4 more dits after the character space make the word space
+                _state = SPACE;
+                return 4 * _dit;
+            }
+            _char = _encode(c); // Unknown characters are skipped
+        }
+        if (_char > 1) {
+            el = _char & 1;
+            _char >>= 1;
+        }
+    }
+
+    if (el < 0) {
+        _state = IDLE;
+        return 0;
+    }
+    _write(true);
+    _state = MARK;
+    return el ? 3 * _dit : _dit;
+}
+
+// The first edge is written right away, so keying latency is one I2C byte
+void Si5351Cw::_kick() {
+    if (_state != IDLE) return;
+#if defined(ARDUINO_ARCH_RP2040)
+    if (_timer) {
+        if (_alarm >= 0) return;
+        uint32_t wait = step();
+        if (wait) {
+            alarm_id_t id = add_alarm_in_us(wait, _onAlarm, this, true);
+            _alarm = id > 0 ? id : -1;
+        }
+        return;
+    }
+#endif
+    uint32_t wait = step();
+    if (wait) {
+        _due = micros() + wait;
+        _polling = true;
+    }
+}
+
+void Si5351Cw::poll(uint32_t nowUs) {
+    if (!_polling || (int32_t)(nowUs - _due) < 0) return;
+    uint32_t wait = step();
+    if (wait) _due += wait; // From the previous edge, so timing errors do not accumulate
+    else _polling = false;
+}
+
+// ============ RP2040 Alarm Runner ============
+
+#if defined(ARDUINO_ARCH_RP2040)
+int64_t Si5351Cw::_onAlarm(int32_t id, void* user) {
+    (void)id;
+    Si5351Cw* cw = static_cast<Si5351Cw*>(user);
+    uint32_t wait = cw->step();
+    if (!wait) cw->_alarm = -1;
+    return wait; // > 0 reschedules from the previous target, so edges do not drift
+}
+
+void Si5351Cw::start() {
+    _timer = true;
+    if (_polling && _alarm < 0) { // Hand the pending edge over to the alarm
+        int32_t left = (int32_t)(_due - micros());
+        alarm_id_t id = add_alarm_in_us(left > 0 ? left : 1, _onAlarm, this, true);
+        _alarm = id > 0 ? id : -1;
+    }
+    _polling = false;
+}
+
+void Si5351Cw::stop() {
+    if (_alarm > 0) cancel_alarm(_alarm);
+    _alarm = -1;
+    _timer = false;
+    _state = IDLE;
+    clear();
+    _write(false);
+}
+#endif
@@ -0,0 +1,102 @@
+#ifndef _SI5351_CW_H_
+#define _SI5351_CW_H_
+/*
+ * si5351_cw.h
+ *
+ * CW keying engine. Keying toggles the output enable register with a single
+ * one-byte write (no read, no register image scan), and the disable-state
+ * register holds the keyed-off output at a clean level instead of wherever the
+ * clock happened to stop.
+ *
+ * Inputs:
+ *   key(down)          straight key, written immediately
+ *   paddles(dit, dah)  iambic keyer with dit/dah memory, squeezing alternates
+ *   send(text)         queued Morse text (A-Z, 0-9, common punctuation, space = word gap)
+ *
+ * Timing follows the PARIS standard: dit = 1200 ms / WPM, dah = 3 dits,
+ * element space 1, character space 3, word space 7. step() advances the
+ * element state machine and returns the time to the next edge. On RP2040
+ * start() runs it from a hardware alarm, so edge jitter is the alarm latency
+ * plus one I2C byte (~50 us at 400 kHz); elsewhere call poll() from loop().
+ * While the keyer runs from the alarm, do not use the driver from other code.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_CW_QUEUE     32 // Queued text characters (one slot is kept free)
+
+class Si5351Cw {
+public:
+    // Key the outputs of one driver VFO
+    explicit Si5351Cw(Si5351& vfo, uint8_t vfoIdx = 1)
+      : _vfo(vfo), _idx(vfoIdx), _mask(vfoIdx == 0 ? 0x03 : 0x04) {}
+
+    // Set the keyed-off level and speed, and key up
+    void begin(uint8_t wpm = 20, uint8_t offState = SI_DIS_LOW);
+
+    void setWpm(uint8_t wpm);
+    uint32_t ditUs() const { return _dit; }
+
+    // Straight key
+    void key(bool down);
+
+    // Current paddle contacts, e.g. from a pin change interrupt or loop()
+    void paddles(bool dit, bool dah);
+
+    // Queue text, false if it did not fit completely
+    bool send(const char* text);
+
+    // Drop queued text and key up
+    void clear();
+
+    bool keyed() const { return _keyed; }
+    bool idle() const { return _state == IDLE; }
+
+    // Advance to the next edge; returns the us until the following one, 0 when idle
+    uint32_t step();
+
+    // Run step() when due, call it often from loop() when not using start()
+    void poll(uint32_t nowUs);
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Run the keyer from a hardware alarm; inputs start it again when it went idle
+    void start();
+    void stop();
+#endif
+
+private:
+    enum { IDLE, MARK, SPACE };
+
+    Si5351& _vfo;
+    uint8_t _idx;
+    uint8_t _mask;                // OE bits of the keyed outputs
+    uint32_t _dit = 60000;        // Dit length in us (20 WPM)
+    volatile uint8_t _state = IDLE;
+    volatile bool _keyed = false;
+
+    volatile bool _ditIn = false, _dahIn = false;   // Paddle contacts
+    volatile bool _ditMem = false, _dahMem = false; // Presses not yet sent
+    uint8_t _last = 0;            // Last paddle element, 1 = dah
+
+    char _queue[SI_CW_QUEUE];     // Text ring
+    volatile uint8_t _head = 0, _tail = 0;
+    uint8_t _char = 0;            // Elements of the character being sent, LSB first under a 1 sentinel
+
+    uint32_t _due = 0;            // poll(): time of the next edge
+    bool _polling = false;        // poll(): an edge is scheduled
+
+#if defined(ARDUINO_ARCH_RP2040)
+    int32_t _alarm = -1;          // Alarm id while running from the alarm
+    bool _timer = false;          // start() was called
+    static int64_t _onAlarm(int32_t id, void* user);
+#endif
+
+    void _write(bool down);       // One-byte OE write
+    void _kick();                 // Start the state machine after an input while idle
+    int8_t _paddleElement();      // 0 = dit, 1 = dah, -1 = none
+    static uint8_t _encode(char c); // Morse pattern, 0 if unknown
+};
+
+#endif
@@ -0,0 +1,70 @@
+#include "si5351_frame.h"
+
+/*
+ * si5351_frame.cpp
+ *
+ * Frame parser and encoder for the binary control protocol.
+ * See si5351_frame.h for the frame layout and commands.
+ */
+
+// CRC-8, polynomial x^8 + x^2 + x + 1 (0x07), MSB first
+uint8_t Si5351FrameParser::crc8(uint8_t crc, uint8_t b) {
+    crc ^= b;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+// Encode SYNC LEN CMD PAYLOAD CRC8 into out
+uint8_t Si5351FrameParser::encode(uint8_t* out, uint8_t cmd, const uint8_t* data, uint8_t len) {
+    uint8_t crc = crc8(crc8(0, len), cmd);
+    out[0] = SI_FRAME_SYNC;
+    out[1] = len;
+    out[2] = cmd;
+    for (uint8_t i = 0; i < len; i++) {
+        out[3 + i] = data[i];
+        crc = crc8(crc, data[i]);
+    }
+    out[3 + len] = crc;
+    return len + SI_FRAME_OVERHEAD;
+}
+
+// Look for SYNC, wait until the whole frame is buffered, then check length and CRC.
+// On any error only the SYNC byte is dropped, so a real frame hidden behind it is still found.
+bool Si5351FrameParser::next(si_frame_t& f) {
+    while (_ring.available() > 0) {
+        if (_ring.peek(0) != SI_FRAME_SYNC) {
+            _ring.drop(1); // Not a frame start
+            continue;
+        }
+        if (_ring.available() < 2) return false; // Length not received yet
+
+        uint8_t len = _ring.peek(1);
+        if (len > SI_FRAME_MAX) {
+            _errors++;
+            _ring.drop(1); // Impossible length, resynchronise
+            continue;
+        }
+        if (_ring.available() < len + SI_FRAME_OVERHEAD) return false; // Frame not complete yet
+
+        uint8_t crc = crc8(0, len);
+        for (uint8_t i = 0; i < len + 1; i++) {
+            crc = crc8(crc, _ring.peek(2 + i)); // CMD and PAYLOAD
+        }
+        if (crc != _ring.peek(3 + len)) {
+            _errors++;
+            _ring.drop(1); // Corrupted frame, resynchronise
+            continue;
+        }
+
+        f.len = len;
+        f.cmd = _ring.peek(2);
+        for (uint8_t i = 0; i < len; i++) {
+            f.data[i] = _ring.peek(3 + i);
+        }
+        _ring.drop(len + SI_FRAME_OVERHEAD);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,94 @@
+#ifndef _SI5351_FRAME_H_
+#define _SI5351_FRAME_H_
+/*
+ * si5351_frame.h
+ *
+ * Binary framed control protocol for the Si5351 driver.
+ * Only depends on <stdint.h>, so the parser can be built and fed on the host.
+ *
+ * Frame: SYNC(0x7E) LEN CMD PAYLOAD[LEN] CRC8
+ * CRC-8 (poly 0x07, init 0x00) covers LEN, CMD and PAYLOAD.
+ * Multi-byte values are little endian.
+ *
+ */
+
+#include <stdint.h>
+
+#define SI_FRAME_SYNC    0x7E // Start of frame marker
+#define SI_FRAME_MAX     60   // Maximum payload length
+#define SI_FRAME_OVERHEAD 4   // SYNC, LEN, CMD and CRC8 bytes around the payload
+#define SI_RING_SIZE     256  // Receive ring buffer size, the uint8_t indices wrap at 256
+
+// Commands (host -> device), replies carry the same code with SI_CMD_REPLY set
+#define SI_CMD_FREQ      0x01 // [vfo u8, freq u32] x 1..12: set frequencies, applied coalesced; 0 Hz is NAKed
+#define SI_CMD_PHASE     0x02 // [vfo u8, phase u8]: set quadrature phase (PH000..PH270)
+#define SI_CMD_ENABLE    0x03 // [vfo u8, en u8]: enable or disable a VFO output
+#define SI_CMD_GET_FREQ  0x10 // [vfo u8] -> [vfo u8, target u32, actual u32]
+#define SI_CMD_GET_STATS 0x11 // [] -> [bytes, transactions, reads, resets, frames, errors, coalesced u32]
+#define SI_CMD_NAK       0x7F // Sent as a reply (0xFF) only: [cmd u8, vfo u8] command rejected
+#define SI_CMD_REPLY     0x80 // Reply flag
+
+// A decoded frame
+typedef struct {
+    uint8_t cmd;                // Command code
+    uint8_t len;                // Payload length
+    uint8_t data[SI_FRAME_MAX]; // Payload
+} si_frame_t;
+
+// Single producer / single consumer byte ring, push() may run in an interrupt handler
+class Si5351Ring {
+public:
+    // Append a byte, false if the ring is full
+    bool push(uint8_t b) {
+        uint8_t h = _head;
+        if ((uint8_t)(h - _tail) == (uint8_t)(SI_RING_SIZE - 1)) return false; // Full
+        _buf[h] = b;
+        _head = h + 1;
+        return true;
+    }
+
+    uint8_t available() const { return (uint8_t)(_head - _tail); } // Bytes waiting
+    uint8_t peek(uint8_t i) const { return _buf[(uint8_t)(_tail + i)]; } // Byte i from the tail
+    void drop(uint8_t n) { _tail = _tail + n; } // Consume n bytes
+
+private:
+    uint8_t _buf[SI_RING_SIZE];
+    volatile uint8_t _head = 0; // Written by the producer only
+    volatile uint8_t _tail = 0; // Written by the consumer only
+};
+
+class Si5351FrameParser {
+public:
+    // Feed received bytes, false if the byte was lost because the ring is full
+    bool push(uint8_t b) { return _ring.push(b); }
+
+    // Extract the next valid frame, resynchronising on garbage or bad CRC
+    bool next(si_frame_t& f);
+
+    // Frames rejected because of a bad length or CRC
+    uint32_t errors() const { return _errors; }
+
+    // Encode a frame into out (SI_FRAME_OVERHEAD + len bytes), returns the frame length
+    static uint8_t encode(uint8_t* out, uint8_t cmd, const uint8_t* data, uint8_t len);
+
+    // CRC-8, polynomial 0x07, continuing from crc
+    static uint8_t crc8(uint8_t crc, uint8_t b);
+
+private:
+    Si5351Ring _ring;
+    uint32_t _errors = 0;
+};
+
+// Little endian helpers for payload fields
+static inline uint32_t siGet32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void siPut32(uint8_t* p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+#endif
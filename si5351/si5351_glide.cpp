@@ -0,0 +1,111 @@
+#include "si5351_glide.h"
+
+/*
+ * si5351_glide.cpp
+ *
+ * Frequency glide, see si5351_glide.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/time.h>
+#include <hardware/timer.h>
+#endif
+
+// 3t^2 - 2t^3 in Q16
+uint16_t Si5351Glide::smooth(uint16_t t) {
+    uint64_t t2 = (uint64_t)t * t;
+    return (uint16_t)((t2 * (3 * 65535ULL - 2ULL * t)) / (65535ULL * 65535ULL));
+}
+
+bool Si5351Glide::start(uint32_t toHz, uint32_t durationUs, uint32_t nowUs, si_glide_curve_t curve) {
+    uint8_t ri, lo, hi;
+    if (!Si5351::dividerRange(_vfo.getXtal(), toHz, ri, lo, hi)) return false;
+    _from = _vfo.getTarget(_idx);
+    if (_from == 0) return false; // Nothing to glide from
+    _to = toHz;
+    _t0 = nowUs;
+    _dur = durationUs;
+    _next = nowUs;
+    _curve = curve ? curve : linear;
+    _steps = 0;
+    _changes = 0;
+    _active = true;
+    return true;
+}
+
+void Si5351Glide::poll(uint32_t nowUs) {
+    if (!_active || (int32_t)(nowUs - _next) < 0) return;
+    _step(nowUs);
+    _next = nowUs + _stepUs; // From now, not from the schedule: a late step never causes a burst
+}
+
+void Si5351Glide::cancel() {
+#if defined(ARDUINO_ARCH_RP2040)
+    if (_alarm > 0) cancel_alarm(_alarm);
+    _alarm = -1;
+#endif
+    _active = false;
+}
+
+SI5351_HOT bool Si5351Glide::_step(uint32_t nowUs) {
+    uint32_t elapsed = nowUs - _t0;
+    if (elapsed >= _dur) {
+        _tune(_to);
+        _active = false;
+        return false;
+    }
+    uint16_t t = (uint16_t)((uint64_t)elapsed * 65535 / _dur);
+    uint16_t pos = _curve(t);
+    int64_t span = (int64_t)_to - _from;
+    if (!_tune((uint32_t)((int64_t)_from + span * pos / 65535))) {
+        _active = false; // The chip is not where the glide thinks, stop here
+        return false;
+    }
+    return true;
+}
+
+// Keep the divider while the VCO allows. Otherwise take the divider that lasts longest toward
+// the target: the VCO moves with the frequency, so start it at the end of its range it moves away from.
+SI5351_HOT bool Si5351Glide::_tune(uint32_t freqHz) {
+    uint32_t xtal = _vfo.getXtal();
+    const vfo_t& cur = _vfo.getVfo(_idx);
+    vfo_t v = cur;
+    bool change = false;
+    if (!Si5351::planDivider(xtal, freqHz, cur.ri, cur.msi, v)) {
+        uint8_t ri, lo, hi;
+        if (!Si5351::dividerRange(xtal, freqHz, ri, lo, hi)) return false;
+        if (!Si5351::planDivider(xtal, freqHz, ri, _to > freqHz ? lo : hi, v)) return false;
+        change = true;
+    }
+    v.phase = cur.phase;
+    if (!_vfo.setVfo(_idx, v) || !_vfo.update(_idx)) return false; // Count only steps that reached the chip
+    _steps++;
+    if (change) _changes++;
+    return true;
+}
+
+// ============ RP2040 Alarm Runner ============
+
+#if defined(ARDUINO_ARCH_RP2040)
+int64_t Si5351Glide::_onAlarm(int32_t id, void* user) {
+    (void)id;
+    Si5351Glide* g = static_cast<Si5351Glide*>(user);
+    if (!g->_active || !g->_step(time_us_32())) {
+        g->_alarm = -1;
+        return 0;
+    }
+    return -(int64_t)g->_stepUs; // Negative: from now, so steps never come closer than _stepUs
+}
+
+bool Si5351Glide::startTimed(uint32_t toHz, uint32_t durationUs, si_glide_curve_t curve) {
+    cancel();
+    if (!start(toHz, durationUs, time_us_32(), curve)) return false;
+    alarm_id_t id = add_alarm_in_us(1, _onAlarm, this, true);
+    if (id <= 0) {
+        _active = false;
+        return false;
+    }
+    _alarm = id;
+    return true;
+}
+#endif
@@ -0,0 +1,82 @@
+#ifndef _SI5351_GLIDE_H_
+#define _SI5351_GLIDE_H_
+/*
+ * si5351_glide.h
+ *
+ * Frequency glide (portamento): moves a VFO from its current frequency to a new
+ * one over a set time along a curve. Each step only rewrites the PLL numerator,
+ * which needs no PLL reset. The MultiSynth divider is kept as long as the VCO
+ * range allows; when it runs out, the new divider is the one that lasts
+ * longest in the direction of travel, so a glide makes only the divider
+ * changes (each with a PLL reset) its span requires: none for a chirp inside
+ * a band, one for 7 -> 14 MHz, two for 3.5 -> 28 MHz.
+ *
+ * Bus use is bounded by the step interval: one numerator write (at most 9
+ * bytes) per step, 1 ms by default, i.e. under 25% of a 400 kHz bus.
+ *
+ * Drive it with poll() from loop(), or on RP2040 with startTimed(), which steps
+ * from a hardware alarm; while it runs from the alarm, do not use the driver
+ * from other code. A step the driver rejects or the bus does not deliver ends
+ * the glide where the chip last was (active() turns false).
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_GLIDE_STEP_US 1000 // Default step interval
+
+// Glide curve: progress 0..65535 to position 0..65535 between the two frequencies
+typedef uint16_t (*si_glide_curve_t)(uint16_t t);
+
+class Si5351Glide {
+public:
+    explicit Si5351Glide(Si5351& vfo, uint8_t vfoIdx = 0)
+      : _vfo(vfo), _idx(vfoIdx) {}
+
+    // Minimum time between two register writes
+    void setStepUs(uint32_t us) { _stepUs = us ? us : 1; }
+
+    // Glide from the current frequency to toHz in durationUs, false if toHz cannot be reached
+    bool start(uint32_t toHz, uint32_t durationUs, uint32_t nowUs, si_glide_curve_t curve = linear);
+
+    // Write the next step when due, call it often from loop()
+    void poll(uint32_t nowUs);
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Same as start(), stepped from a hardware alarm
+    bool startTimed(uint32_t toHz, uint32_t durationUs, si_glide_curve_t curve = linear);
+#endif
+
+    // Stop where the glide is now
+    void cancel();
+
+    bool active() const { return _active; }
+    uint32_t steps() const { return _steps; }     // Register updates in the last glide
+    uint32_t changes() const { return _changes; } // Divider changes (PLL resets) in the last glide
+
+    // Curves
+    static uint16_t linear(uint16_t t) { return t; }
+    static uint16_t smooth(uint16_t t); // Ease in and out (smoothstep)
+
+private:
+    Si5351& _vfo;
+    uint8_t _idx;
+    uint32_t _stepUs = SI_GLIDE_STEP_US;
+    uint32_t _from = 0, _to = 0;
+    uint32_t _t0 = 0, _dur = 0;
+    uint32_t _next = 0;             // Time of the next step
+    si_glide_curve_t _curve = linear;
+    volatile bool _active = false;
+    uint32_t _steps = 0, _changes = 0;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    int32_t _alarm = -1;
+    static int64_t _onAlarm(int32_t id, void* user);
+#endif
+
+    bool _step(uint32_t nowUs);     // Write the position for nowUs, false once the glide has ended
+    bool _tune(uint32_t freqHz);    // Retune, keeping the divider if possible, false if the write failed
+};
+
+#endif
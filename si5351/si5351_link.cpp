@@ -0,0 +1,104 @@
+#include "si5351_link.h"
+
+/*
+ * si5351_link.cpp
+ *
+ * Binary control link for the Si5351 driver, see si5351_link.h.
+ */
+
+// Drain the port into the parser, run every complete frame, then apply what is pending
+void Si5351Link::poll() {
+    si_frame_t f;
+    bool more = true;
+    while (more) {
+        more = false;
+        while (_port.available() > 0) {
+            if (!_parser.push((uint8_t)_port.peek())) { more = true; break; } // Ring full, parse first
+            _port.read();
+        }
+        while (_parser.next(f)) {
+            _frames++;
+            _handle(f);
+        }
+    }
+
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        _apply(i);
+    }
+}
+
+// Execute one decoded frame; frequency and phase only become pending, queries answer at once
+void Si5351Link::_handle(const si_frame_t& f) {
+    switch (f.cmd) {
+        case SI_CMD_FREQ:
+            if (f.len == 0 || f.len % 5) break; // [vfo, freq] entries
+            for (uint8_t i = 0; i < f.len; i += 5) {
+                uint8_t v = f.data[i];
+                uint32_t hz = siGet32(&f.data[i + 1]);
+                if (v >= SI5351_VFO_COUNT || !hz) { _nak(f.cmd, v); continue; } // No such VFO, or 0 Hz
+                if (_pending & (1 << v)) _coalesced++; // Previous target never reached the chip
+                _pendingFreq[v] = hz;
+                _pending |= 1 << v;
+            }
+            return;
+
+        case SI_CMD_PHASE:
+            if (f.len != 2 || f.data[0] != 0 || f.data[1] > PH270) break; // Only VFO0 has a phase
+            _vfo.setPhase(0, f.data[1]);
+            _pending |= 1 << 0; // Phase is written by the next update
+            return;
+
+        case SI_CMD_ENABLE:
+            if (f.len != 2 || f.data[0] >= SI5351_VFO_COUNT) break;
+            _vfo.enable(f.data[0], f.data[1] != 0); // A single register write, not worth deferring
+            return;
+
+        case SI_CMD_GET_FREQ: {
+            if (f.len != 1 || f.data[0] >= SI5351_VFO_COUNT) break;
+            uint8_t v = f.data[0];
+            _apply(v); // Answer with what is really on the chip
+            uint8_t r[9];
+            r[0] = v;
+            siPut32(&r[1], _vfo.getTarget(v));
+            siPut32(&r[5], _vfo.getFreq(v));
+            _reply(f.cmd, r, sizeof(r));
+            return;
+        }
+
+        case SI_CMD_GET_STATS: {
+            const si_stats_t& s = _vfo.stats();
+            uint8_t r[28];
+            siPut32(&r[0], s.bytes);
+            siPut32(&r[4], s.transactions);
+            siPut32(&r[8], s.reads);
+            siPut32(&r[12], s.resets);
+            siPut32(&r[16], _frames);
+            siPut32(&r[20], _parser.errors());
+            siPut32(&r[24], _coalesced);
+            _reply(f.cmd, r, sizeof(r));
+            return;
+        }
+    }
+    _nak(f.cmd, f.len ? f.data[0] : 0xFF); // Unknown command or malformed payload
+}
+
+// Plan and write the newest target of a VFO, one bus update however many frames asked for it
+void Si5351Link::_apply(uint8_t vfoIdx) {
+    if (!(_pending & (1 << vfoIdx))) return;
+    _pending &= ~(1 << vfoIdx);
+    if (_pendingFreq[vfoIdx] && !_vfo.setFreq(vfoIdx, _pendingFreq[vfoIdx])) {
+        _nak(SI_CMD_FREQ, vfoIdx); // Frequency out of range, previous one stays
+        return;
+    }
+    _vfo.update(vfoIdx);
+}
+
+void Si5351Link::_reply(uint8_t cmd, const uint8_t* data, uint8_t len) {
+    uint8_t buf[SI_FRAME_MAX + SI_FRAME_OVERHEAD];
+    _port.write(buf, Si5351FrameParser::encode(buf, cmd | SI_CMD_REPLY, data, len));
+}
+
+void Si5351Link::_nak(uint8_t cmd, uint8_t vfoIdx) {
+    uint8_t r[2] = {cmd, vfoIdx};
+    _reply(SI_CMD_NAK, r, sizeof(r));
+}
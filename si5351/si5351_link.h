@@ -0,0 +1,51 @@
+#ifndef _SI5351_LINK_H_
+#define _SI5351_LINK_H_
+/*
+ * si5351_link.h
+ *
+ * Binary control link: reads frames (see si5351_frame.h) from a serial port,
+ * e.g. USB CDC, and applies them to the Si5351 driver.
+ *
+ * Frequency commands are coalesced: every SI_CMD_FREQ only replaces the pending
+ * target of its VFO, and poll() applies each pending target once. A stream that
+ * arrives faster than the bus can apply it therefore never builds up a backlog,
+ * the driver always jumps to the newest frequency.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+#include "si5351_frame.h"
+
+class Si5351Link {
+public:
+    Si5351Link(Si5351& vfo, Stream& port)
+      : _vfo(vfo), _port(port) {}
+
+    // Receive, decode and apply pending commands, call it from loop()
+    void poll();
+
+    // Frames accepted, and frequency updates replaced before they were applied
+    uint32_t frames() const { return _frames; }
+    uint32_t coalesced() const { return _coalesced; }
+
+    // Parser, e.g. to push bytes from a receive interrupt instead of poll()
+    Si5351FrameParser& parser() { return _parser; }
+
+private:
+    Si5351& _vfo;
+    Stream& _port;
+    Si5351FrameParser _parser;
+
+    uint32_t _pendingFreq[SI5351_VFO_COUNT] = {}; // Newest requested frequency per VFO
+    uint8_t _pending = 0;                         // Bit per VFO with a pending frequency or phase
+    uint32_t _frames = 0;
+    uint32_t _coalesced = 0;
+
+    void _handle(const si_frame_t& f); // Execute one frame
+    void _apply(uint8_t vfoIdx);       // Apply the pending state of a VFO
+    void _reply(uint8_t cmd, const uint8_t* data, uint8_t len); // Send a reply frame
+    void _nak(uint8_t cmd, uint8_t vfoIdx); // Reject a command
+};
+
+#endif
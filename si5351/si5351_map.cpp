@@ -0,0 +1,145 @@
+#include "si5351_map.h"
+
+/*
+ * si5351_map.cpp
+ *
+ * Register map import and export, see si5351_map.h.
+ */
+
+void Si5351Map::clear() {
+    memset(_regs, 0, sizeof(_regs));
+    memset(_mask, 0, sizeof(_mask));
+    _errorLine = 0;
+}
+
+void Si5351Map::set(uint8_t reg, uint8_t val) {
+    if (reg >= SI_REG_COUNT) return;
+    _regs[reg] = val;
+    _mask[reg >> 3] |= 1 << (reg & 7);
+}
+
+uint16_t Si5351Map::size() const {
+    uint16_t n = 0;
+    for (uint8_t r = 0; r < SI_REG_COUNT; r++) n += has(r);
+    return n;
+}
+
+void Si5351Map::capture(const Si5351& vfo) {
+    clear();
+    for (uint8_t r = 0; r < SI_REG_COUNT; r++) {
+        if (vfo.known(r)) set(r, vfo.reg(r));
+    }
+}
+
+// ============ Text ============
+
+static int8_t hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// "address,value": decimal address, hex value as "XXh", "0xXX" or bare "XX"; spaces allowed around both
+bool Si5351Map::parseLine(const char* line) {
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line == '\0' || *line == '\r' || *line == '\n' || *line == '#') return true;
+    if (*line < '0' || *line > '9') return strncmp(line, "Address", 7) == 0; // Column header
+
+    uint16_t reg = 0;
+    while (*line >= '0' && *line <= '9') {
+        reg = reg * 10 + (*line++ - '0');
+        if (reg >= SI_REG_COUNT) return false;
+    }
+    while (*line == ' ' || *line == '\t') line++;
+    if (*line++ != ',') return false;
+    while (*line == ' ' || *line == '\t') line++;
+    if (line[0] == '0' && (line[1] == 'x' || line[1] == 'X')) line += 2;
+
+    uint16_t val = 0;
+    uint8_t digits = 0;
+    for (int8_t d; (d = hexDigit(*line)) >= 0; line++) {
+        val = val << 4 | d;
+        if (++digits > 2) return false;
+    }
+    if (!digits) return false;
+    if (*line == 'h' || *line == 'H') line++;
+    while (*line == ' ' || *line == '\t' || *line == '\r') line++;
+    if (*line != '\0' && *line != '\n') return false;
+    set((uint8_t)reg, (uint8_t)val);
+    return true;
+}
+
+bool Si5351Map::parse(const char* text) {
+    char line[SI_MAP_LINE + 1];
+    uint16_t number = 0;
+    _errorLine = 0;
+    while (*text) {
+        number++;
+        uint8_t n = 0;
+        bool fits = true;
+        for (; *text && *text != '\n'; text++) {
+            if (n < SI_MAP_LINE) line[n++] = *text;
+            else fits = false;
+        }
+        if (*text == '\n') text++;
+        line[n] = '\0';
+        if (!fits && line[0] != '#') { // Long comments are fine, long register lines are not
+            _errorLine = number;
+            return false;
+        }
+        if (!parseLine(line)) {
+            _errorLine = number;
+            return false;
+        }
+    }
+    return true;
+}
+
+void Si5351Map::print(Print& out) const {
+    out.println("# Si5351 register map");
+    out.println("#REGISTER_MAP");
+    for (uint8_t r = 0; r < SI_REG_COUNT; r++) {
+        if (!has(r)) continue;
+        out.print(r);
+        out.print(_regs[r] < 0x10 ? ",0" : ",");
+        out.print(_regs[r], HEX);
+        out.println("h");
+    }
+    out.println("#END_REGISTER_MAP");
+}
+
+// ============ Binary ============
+
+uint16_t Si5351Map::pack(uint8_t* buf, uint16_t size) const {
+    uint16_t n = 0;
+    uint8_t r = 0;
+    while (r < SI_REG_COUNT) {
+        if (!has(r)) {
+            r++;
+            continue;
+        }
+        uint8_t len = 0;
+        while (r + len < SI_REG_COUNT && has(r + len) && len < 0xFF) len++;
+        if (n + 2 + len > size) return 0;
+        buf[n++] = r;
+        buf[n++] = len;
+        memcpy(buf + n, &_regs[r], len);
+        n += len;
+        r += len;
+    }
+    return n;
+}
+
+bool Si5351Map::unpack(const uint8_t* buf, uint16_t len) {
+    uint16_t i = 0;
+    while (i < len) {
+        if (i + 2 > len) return false;
+        uint8_t reg = buf[i], n = buf[i + 1];
+        i += 2;
+        if (i + n > len || reg + n > SI_REG_COUNT) return false;
+        for (uint8_t k = 0; k < n; k++) set(reg + k, buf[i + k]);
+        i += n;
+    }
+    return true;
+}
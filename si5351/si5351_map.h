@@ -0,0 +1,80 @@
+#ifndef _SI5351_MAP_H_
+#define _SI5351_MAP_H_
+/*
+ * si5351_map.h
+ *
+ * Full register maps in the ClockBuilder text export format, and in a compact
+ * binary form, to bulk-load a plan validated in the vendor tool or to dump the
+ * driver's register image for comparison.
+ *
+ * Text: one "address,value" line per register, the address in decimal and the
+ * value in hex with an "h" suffix (or a "0x" prefix). Lines starting with '#'
+ * (#REGISTER_MAP, #END_REGISTER_MAP, comments) and an "Address,Data" header are
+ * skipped:
+ *
+ *   #REGISTER_MAP
+ *   3,FFh
+ *   16,4Fh
+ *   ...
+ *   #END_REGISTER_MAP
+ *
+ * Binary: runs of consecutive registers, "reg(1) len(1) data[len]" each, as many
+ * as fill the buffer. A run has the layout of a SI_REC_REGS record of
+ * si5351_store.h, so a map can also go into a store image run by run.
+ *
+ * Loading goes through Si5351::load(): outputs off, the registers that differ
+ * from the chip in as few transactions as possible, one reset of both PLLs,
+ * outputs on.
+ *
+ *   Si5351Map map;
+ *   map.parse(exportText);
+ *   map.load(vfo);
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_MAP_LINE     24 // Longest text line parse() accepts, without the line end
+
+class Si5351Map {
+public:
+    Si5351Map() { clear(); }
+
+    void clear();
+    void set(uint8_t reg, uint8_t val);
+    bool has(uint8_t reg) const { return reg < SI_REG_COUNT && (_mask[reg >> 3] & (1 << (reg & 7))); }
+    uint8_t get(uint8_t reg) const { return has(reg) ? _regs[reg] : 0; }
+    uint16_t size() const; // Registers in the map
+
+    // Take every register the driver has written or staged, i.e. its view of the chip
+    void capture(const Si5351& vfo);
+
+    // Write the map to the chip, false if a write failed, see Si5351::load()
+    bool load(Si5351& vfo) const { return vfo.load(_regs, _mask); }
+
+    // Add one text line to the map, false if it is malformed or the address out of range; comments,
+    // blank lines and the header are accepted and ignored
+    bool parseLine(const char* line);
+
+    // A whole text export (lines ended by "\n" or "\r\n"), false at the first bad line; errorLine()
+    // gives its number (1-based)
+    bool parse(const char* text);
+    uint16_t errorLine() const { return _errorLine; }
+
+    // The map as a text export, registers in address order
+    void print(Print& out) const;
+
+    // Binary runs into buf, returns the bytes used or 0 if they do not fit
+    uint16_t pack(uint8_t* buf, uint16_t size) const;
+
+    // Add binary runs to the map, false if a run is truncated or out of range
+    bool unpack(const uint8_t* buf, uint16_t len);
+
+private:
+    uint8_t _regs[SI_REG_COUNT];
+    uint8_t _mask[(SI_REG_COUNT + 7) / 8]; // Bit set when a register is in the map
+    uint16_t _errorLine = 0;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "si5351_pio.h"
+#include "si5351.h"
+
+/*
+ * si5351_pio.cpp
+ *
+ * PIO I2C master, see si5351_pio.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/clocks.h>
+#include <hardware/dma.h>
+#include <hardware/gpio.h>
+#endif
+
+// ============ Frame Builder ============
+
+namespace {
+
+// Appends ticks as pin directions: 1 = pull the line low, 0 = release it
+struct Wave {
+    uint32_t* w;
+    uint16_t n;
+
+    void tick(bool sda, bool scl) {
+        uint32_t dirs = (sda ? 0 : 1) | (scl ? 0 : 2); // out pindirs, 2: SDA bit 0, SCL bit 1
+        if ((n & 15) == 0) w[n >> 4] = 0;
+        w[n >> 4] |= dirs << ((n & 15) * 2);
+        n++;
+    }
+    void bit(bool b) { tick(b, false); tick(b, true); tick(b, true); tick(b, false); }
+    void start() { tick(true, true); tick(false, true); tick(false, false); } // From idle
+    void restart() { tick(true, false); tick(true, true); tick(false, true); tick(false, false); }
+    void stop() { tick(false, false); tick(false, true); tick(true, true); tick(true, true); }
+    void pad() { while (n & 31) tick(true, true); } // Idle up to a whole RX word
+
+    // Byte MSB first, then the ACK slot with SDA released; returns the ACK sample index
+    uint16_t byte(uint8_t v) {
+        for (int8_t i = 7; i >= 0; i--) bit((v >> i) & 1);
+        uint16_t ack = n + 2;
+        bit(true);
+        return ack;
+    }
+};
+
+} // namespace
+
+SI5351_HOT uint16_t Si5351PioBus::buildWrite(uint32_t* tx, uint16_t* ack, uint8_t addr, const uint8_t* head,
+                                             uint8_t headLen, const uint8_t* data, uint16_t len) {
+    if (headLen + len > SI_PIO_MAX_BYTES) return 0;
+    Wave w = {tx, 0};
+    w.start();
+    *ack++ = w.byte(addr << 1);
+    for (uint8_t i = 0; i < headLen; i++) *ack++ = w.byte(head[i]);
+    for (uint16_t i = 0; i < len; i++) *ack++ = w.byte(data[i]);
+    w.stop();
+    w.pad();
+    return w.n;
+}
+
+// The master ACKs every byte but the last, which it NACKs before the STOP
+uint16_t Si5351PioBus::buildRead(uint32_t* tx, uint16_t* ack, uint16_t* first, uint8_t addr, const uint8_t* head,
+                                 uint8_t headLen, uint16_t len) {
+    if (headLen + len > SI_PIO_MAX_BYTES || !len) return 0;
+    Wave w = {tx, 0};
+    w.start();
+    if (headLen) {
+        *ack++ = w.byte(addr << 1);
+        for (uint8_t i = 0; i < headLen; i++) *ack++ = w.byte(head[i]);
+        w.restart();
+    }
+    *ack++ = w.byte(addr << 1 | 1);
+    *first = w.n + 2;
+    for (uint16_t i = 0; i < len; i++) {
+        for (uint8_t b = 0; b < 8; b++) w.bit(true); // Released, the slave drives SDA
+        w.bit(i + 1 == len);
+    }
+    w.stop();
+    w.pad();
+    return w.n;
+}
+
+// ============ Transfers ============
+
+SI5351_HOT bool Si5351PioBus::write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) {
+    uint16_t ticks = buildWrite(_tx, _ack, addr, head, headLen, data, len);
+    if (!ticks || !_run(ticks)) return false;
+    for (uint16_t i = 0; i < 1 + headLen + len; i++) {
+        if (sample(_rx, _ack[i])) { // SDA high in an ACK slot: NACK, the slave ignored the rest
+            _nacks++;
+            return false;
+        }
+    }
+    return true;
+}
+
+SI5351_HOT bool Si5351PioBus::read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) {
+    uint16_t first;
+    uint16_t ticks = buildRead(_tx, _ack, &first, addr, head, headLen, len);
+    if (!ticks || !_run(ticks)) return false;
+    uint8_t acks = headLen ? headLen + 2 : 1; // Address and head bytes, then the address again
+    for (uint8_t i = 0; i < acks; i++) {
+        if (sample(_rx, _ack[i])) {
+            _nacks++;
+            return false;
+        }
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        uint8_t v = 0;
+        for (uint8_t b = 0; b < 8; b++) v = v << 1 | sample(_rx, first + 36 * i + 4 * b);
+        data[i] = v;
+    }
+    return true;
+}
+
+// ============ RP2040 State Machine ============
+
+#if defined(ARDUINO_ARCH_RP2040)
+// Two instructions per tick, so the state machine runs at 8 times the SCL rate
+static const uint16_t pioProgram[] = {
+    0x6082, // out pindirs, 2   ; SDA and SCL for this tick (autopull)
+    0x4001  // in  pins, 1      ; sample SDA (autopush)
+};
+static const pio_program_t pioI2c = {pioProgram, 2, -1};
+
+void Si5351PioBus::begin() {
+    if (_ready || _scl != _sda + 1) return;
+    PIO pios[2] = {pio0, pio1};
+    for (uint8_t i = 0; i < 2 && !_pio; i++) {
+        if (!pio_can_add_program(pios[i], &pioI2c)) continue;
+        int sm = pio_claim_unused_sm(pios[i], false);
+        if (sm < 0) continue;
+        _pio = pios[i];
+        _sm = sm;
+    }
+    if (!_pio) return;
+    _dmaTx = dma_claim_unused_channel(false);
+    _dmaRx = dma_claim_unused_channel(false);
+    if (_dmaTx < 0 || _dmaRx < 0) {
+        if (_dmaTx >= 0) dma_channel_unclaim(_dmaTx);
+        if (_dmaRx >= 0) dma_channel_unclaim(_dmaRx);
+        pio_sm_unclaim(_pio, _sm);
+        _pio = nullptr;
+        return;
+    }
+    _offset = pio_add_program(_pio, &pioI2c);
+
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, _offset, _offset + 1);
+    sm_config_set_out_pins(&c, _sda, 2);
+    sm_config_set_in_pins(&c, _sda);
+    sm_config_set_out_shift(&c, true, true, 32); // Tick 0 in bits 1:0
+    sm_config_set_in_shift(&c, true, true, 32);  // Sample 0 ends up in bit 0
+
+    uint32_t mask = (1u << _sda) | (1u << _scl);
+    pio_sm_set_pins_with_mask(_pio, _sm, 0, mask);    // Output level 0: open drain
+    pio_sm_set_pindirs_with_mask(_pio, _sm, 0, mask); // Both lines released
+    gpio_pull_up(_sda);
+    gpio_pull_up(_scl);
+    pio_gpio_init(_pio, _sda);
+    pio_gpio_init(_pio, _scl);
+    pio_sm_init(_pio, _sm, _offset, &c);
+    _ready = true;
+    setClock(_hz);
+    pio_sm_set_enabled(_pio, _sm, true);
+}
+
+// Clock divider in 1/256 steps: sys / (8 * hz)
+void Si5351PioBus::setClock(uint32_t hz) {
+    _hz = hz;
+    if (!_ready) return;
+    uint32_t div = (uint32_t)(((uint64_t)clock_get_hz(clk_sys) * 32) / hz);
+    if (div < 0x100) div = 0x100; // 1.0 is the fastest
+    pio_sm_set_clkdiv_int_frac(_pio, _sm, div >> 8, div & 0xFF);
+}
+
+SI5351_HOT bool Si5351PioBus::_run(uint16_t ticks) {
+    if (!_ready) return false;
+    dma_channel_config rx = dma_channel_get_default_config(_dmaRx);
+    channel_config_set_transfer_data_size(&rx, DMA_SIZE_32);
+    channel_config_set_read_increment(&rx, false);
+    channel_config_set_write_increment(&rx, true);
+    channel_config_set_dreq(&rx, pio_get_dreq(_pio, _sm, false));
+    dma_channel_configure(_dmaRx, &rx, _rx, &_pio->rxf[_sm], ticks / 32, true);
+
+    dma_channel_config tx = dma_channel_get_default_config(_dmaTx);
+    channel_config_set_transfer_data_size(&tx, DMA_SIZE_32);
+    channel_config_set_read_increment(&tx, true);
+    channel_config_set_write_increment(&tx, false);
+    channel_config_set_dreq(&tx, pio_get_dreq(_pio, _sm, true));
+    dma_channel_configure(_dmaTx, &tx, &_pio->txf[_sm], _tx, ticks / 16, true);
+
+    dma_channel_wait_for_finish_blocking(_dmaRx); // The last samples come in after the STOP
+    return true;
+}
+#else
+void Si5351PioBus::setClock(uint32_t hz) {
+    _hz = hz;
+}
+
+bool Si5351PioBus::_run(uint16_t ticks) {
+    (void)ticks;
+    return false; // No PIO outside RP2040
+}
+#endif
@@ -0,0 +1,94 @@
+#ifndef _SI5351_PIO_H_
+#define _SI5351_PIO_H_
+/*
+ * si5351_pio.h
+ *
+ * PIO I2C master for RP2040, a Si5351Bus backend for Fast-mode Plus (1 MHz)
+ * and faster. The state machine is a two-instruction waveform player: every
+ * bus tick (a quarter of an SCL period) it sets the SDA/SCL pin directions
+ * from a prebuilt frame and samples SDA. Lines are open drain: the output level
+ * is 0, a pin set to output pulls its line low, an input releases it.
+ *
+ * A transfer builds the whole frame in RAM (START, bytes, ACK slots, STOP),
+ * and two DMA channels stream it to the TX FIFO and the SDA samples back from
+ * the RX FIFO; ACKs and read data are then taken from the samples. There is no
+ * per-byte CPU work and no clock stretching (the Si5351 does not stretch).
+ *
+ * Per bit: tick 0 SCL low, SDA set | 1, 2 SCL high (SDA sampled on 2) | 3 SCL low
+ * i.e. 500 ns low and 500 ns high at 1 MHz. Rise times at that rate need
+ * stronger pull-ups than a 400 kHz bus (e.g. 1 kOhm). The Si5351 datasheet only
+ * specifies 400 kHz; check with nacks() that the part keeps up at the rate set.
+ *
+ *   Si5351PioBus pio(4, 5);  // SDA = GPIO4, SCL = GPIO5 (SCL must be SDA + 1)
+ *   si5351.setBus(&pio);     // before begin(); Wire must not use these pins
+ *
+ * The frame builder also compiles outside RP2040; test/test_pio.cpp plays its
+ * frames against a bus model with a slave on the host.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351_bus.h"
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <hardware/pio.h>
+#endif
+
+#define SI_PIO_HZ        1000000 // Default SCL rate (Fast-mode Plus)
+#define SI_PIO_MAX_BYTES 64      // Head + data bytes per transaction
+
+// Frame sizes: START 3 ticks, 36 ticks per byte with its ACK, repeated START 4, STOP 4, padded
+// to whole RX words (32 samples)
+#define SI_PIO_TICKS(bytes) ((((bytes) * 36 + 3 + 4 + 4) + 31) & ~31)
+#define SI_PIO_MAX_TICKS    SI_PIO_TICKS(SI_PIO_MAX_BYTES + 2)
+
+class Si5351PioBus : public Si5351Bus {
+public:
+    Si5351PioBus(uint8_t sdaPin, uint8_t sclPin, uint32_t hz = SI_PIO_HZ)
+      : _sda(sdaPin), _scl(sclPin), _hz(hz) {}
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Claim a state machine and two DMA channels, set the pins up as open drain with pull-ups
+    void begin() override;
+#endif
+    void setClock(uint32_t hz) override;
+    uint16_t maxWrite() const override { return SI_PIO_MAX_BYTES; }
+
+    bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) override;
+    bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) override;
+
+    uint32_t nacks() const { return _nacks; } // Transfers that were not acknowledged
+    bool ready() const { return _ready; }     // begin() succeeded
+
+    // Frame builders: pin-direction words (2 bits per tick, LSB first) into tx, returns the
+    // tick count or 0 if too long; ack[] gets the sample index of every ACK slot
+    static uint16_t buildWrite(uint32_t* tx, uint16_t* ack, uint8_t addr, const uint8_t* head, uint8_t headLen,
+                               const uint8_t* data, uint16_t len);
+    // Read: ack[] covers the address and head bytes, data bit 7 of byte i is sample *first + 36 * i
+    static uint16_t buildRead(uint32_t* tx, uint16_t* ack, uint16_t* first, uint8_t addr, const uint8_t* head,
+                              uint8_t headLen, uint16_t len);
+
+    // SDA sample k of a frame (1 = high)
+    static bool sample(const uint32_t* rx, uint16_t k) { return (rx[k >> 5] >> (k & 31)) & 1; }
+
+private:
+    uint8_t _sda, _scl;
+    uint32_t _hz;
+    uint32_t _nacks = 0;
+    bool _ready = false;
+
+    uint32_t _tx[SI_PIO_MAX_TICKS / 16]; // Frame, 16 ticks per word
+    uint32_t _rx[SI_PIO_MAX_TICKS / 32]; // SDA samples, 32 per word
+    uint16_t _ack[SI_PIO_MAX_BYTES + 2];
+
+#if defined(ARDUINO_ARCH_RP2040)
+    PIO _pio = nullptr;
+    int _sm = -1;
+    int _dmaTx = -1, _dmaRx = -1;
+    uint _offset = 0;
+#endif
+
+    bool _run(uint16_t ticks); // Play a frame and collect its samples, false if the bus is not ready
+};
+
+#endif
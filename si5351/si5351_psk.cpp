@@ -0,0 +1,180 @@
+#include "si5351_psk.h"
+
+/*
+ * si5351_psk.cpp
+ *
+ * BPSK/QPSK modulation engine, see si5351_psk.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/time.h>
+#endif
+
+// PSK31 varicode for ' ' .. '~', sent MSB first; every code starts and ends with 1 and has no "00"
+static const uint16_t varicode[95] = {
+    0x001, 0x1FF, 0x15F, 0x1F5, 0x1DB, 0x2D5, 0x2BB, 0x17F, 0x0FB, 0x0F7, 0x16F, 0x1DF,
+    0x075, 0x035, 0x057, 0x1AF, 0x0B7, 0x0BD, 0x0ED, 0x0FF, 0x177, 0x15B, 0x16B, 0x1AD,
+    0x1AB, 0x1B7, 0x0F5, 0x1BD, 0x1ED, 0x055, 0x1D7, 0x2AF, 0x2BD, 0x07D, 0x0EB, 0x0AD,
+    0x0B5, 0x077, 0x0DB, 0x0FD, 0x155, 0x07F, 0x1FD, 0x17D, 0x0D7, 0x0BB, 0x0DD, 0x0AB,
+    0x0D5, 0x1DD, 0x0AF, 0x06F, 0x06D, 0x157, 0x1B5, 0x15D, 0x175, 0x17B, 0x2AD, 0x1F7,
+    0x1EF, 0x1FB, 0x2BF, 0x16D, 0x2DF, 0x00B, 0x05F, 0x02F, 0x02D, 0x003, 0x03D, 0x05B,
+    0x02B, 0x00D, 0x1EB, 0x0BF, 0x01B, 0x03B, 0x00F, 0x007, 0x03F, 0x1BF, 0x015, 0x017,
+    0x005, 0x037, 0x07B, 0x06B, 0x0DF, 0x05D, 0x1D5, 0x2B7, 0x1BB, 0x2B5, 0x2D7
+};
+#define VARICODE_LF 0x01D
+#define VARICODE_CR 0x01F
+
+// ============ Symbol Images ============
+
+// Phase 0 is the driver's own state; 180° flips the inversion bit, 90° adds a quarter of the
+// MultiSynth output period to PHOFF (msi VCO quarter periods, as the driver does for CLK1)
+bool Si5351Psk::begin(uint8_t mode, uint32_t symbolUs) {
+    if (_idx >= SI5351_VFO_COUNT) return false;
+    uint8_t n = _idx == 0 ? 2 : 1;
+    uint8_t ctlReg = _idx == 0 ? SI_CLK0_CTL : SI_CLK2_CTL;
+    uint8_t phReg = _idx == 0 ? SI_CLK0_PHOFF : SI_CLK2_PHOFF;
+    uint8_t msi = _vfo.getVfo(_idx).msi;
+
+    for (uint8_t p = 0; p < 4; p++) {
+        for (uint8_t i = 0; i < n; i++) {
+            _img[p].ctl[i] = _vfo.reg(ctlReg + i) ^ ((p & 2) ? SI_CLK_INV : 0);
+            uint16_t ph = _vfo.reg(phReg + i) + ((p & 1) ? msi : 0);
+            if (ph > 0x7F) { // PHOFF is 7 bits
+                if (mode == SI_PSK_QPSK) return false;
+                ph = 0; // Never used in BPSK
+            }
+            _img[p].phoff[i] = (uint8_t)ph;
+        }
+    }
+    _mode = mode;
+    _symUs = symbolUs;
+    _cur = 0;
+    _enc = 0;
+    _head = _tail = 0;
+    _resets = 0;
+    return true;
+}
+
+SI5351_HOT void Si5351Psk::_apply(uint8_t phase) {
+    uint8_t n = _idx == 0 ? 2 : 1;
+    const uint8_t* ctlA = _img[_cur].ctl;
+    const uint8_t* ctlB = _img[phase].ctl;
+    const uint8_t* phA = _img[_cur].phoff;
+    const uint8_t* phB = _img[phase].phoff;
+
+    if (ctlA[0] != ctlB[0] || (n == 2 && ctlA[1] != ctlB[1])) {
+        _vfo.writeRegs(_idx == 0 ? SI_CLK0_CTL : SI_CLK2_CTL, ctlB, n);
+    }
+    if (phA[0] != phB[0] || (n == 2 && phA[1] != phB[1])) {
+        uint8_t reset = _idx == 0 ? SI_PLL_RESET_A : SI_PLL_RESET_B;
+        _vfo.writeRegs(_idx == 0 ? SI_CLK0_PHOFF : SI_CLK2_PHOFF, phB, n);
+        _vfo.writeRegs(SI_PLL_RESET, &reset, 1); // The new offset only takes effect on reset
+        _resets++;
+    }
+    _cur = phase;
+}
+
+// ============ Symbol Queue ============
+
+bool Si5351Psk::symbol(uint8_t phase) {
+    uint8_t h = _head;
+    if ((uint8_t)(h + 1) == _tail) return false; // Full
+    phase &= 3;
+    if (_mode == SI_PSK_BPSK) phase &= 2;
+    _queue[h] = phase;
+    _head = h + 1;
+    _enc = phase;
+    return true;
+}
+
+bool Si5351Psk::idle(uint16_t symbols) {
+    while (symbols--) {
+        if (!symbol(_enc ^ 2)) return false;
+    }
+    return true;
+}
+
+// Differential BPSK: a 0 bit reverses the phase, a 1 bit keeps it
+bool Si5351Psk::_bits(uint16_t code) {
+    uint8_t len = 0;
+    while ((code >> len) > 1) len++; // Index of the leading 1
+    uint8_t free = (uint8_t)(_tail - _head - 1);
+    if (free < len + 3) return false; // Code bits plus the "00" separator
+    for (int8_t i = len; i >= 0; i--) {
+        symbol((code >> i) & 1 ? _enc : _enc ^ 2);
+    }
+    symbol(_enc ^ 2);
+    symbol(_enc ^ 2);
+    return true;
+}
+
+bool Si5351Psk::sendVaricode(const char* text) {
+    for (; *text; text++) {
+        char c = *text;
+        uint16_t code;
+        if (c == '\n') code = VARICODE_LF;
+        else if (c == '\r') code = VARICODE_CR;
+        else if (c >= ' ' && c <= '~') code = varicode[c - ' '];
+        else continue; // Not in the table
+        if (!_bits(code)) return false;
+    }
+    return true;
+}
+
+// ============ Symbol Clock ============
+
+SI5351_HOT uint32_t Si5351Psk::step() {
+    uint8_t t = _tail;
+    if (t == _head) {
+        _running = false;
+        return 0;
+    }
+    _apply(_queue[t]);
+    _tail = t + 1;
+    _running = true;
+    return _symUs;
+}
+
+void Si5351Psk::poll(uint32_t nowUs) {
+    if (_running && (int32_t)(nowUs - _due) < 0) return;
+    if (!_running && _head == _tail) return;
+    if (!_running) _due = nowUs; // First symbol starts now
+    uint32_t wait = step();
+    if (wait) _due += wait; // From the previous boundary, so symbols do not drift
+}
+
+void Si5351Psk::end() {
+#if defined(ARDUINO_ARCH_RP2040)
+    stop();
+#endif
+    _head = _tail;
+    _running = false;
+    if (_cur != 0) _apply(0);
+}
+
+// ============ RP2040 Alarm Runner ============
+
+#if defined(ARDUINO_ARCH_RP2040)
+int64_t Si5351Psk::_onAlarm(int32_t id, void* user) {
+    (void)id;
+    Si5351Psk* psk = static_cast<Si5351Psk*>(user);
+    uint32_t wait = psk->step();
+    if (!wait) psk->_alarm = -1;
+    return wait; // > 0 reschedules from the previous target, so symbols do not drift
+}
+
+// Sends what is queued; call it again after queueing more once the queue ran empty
+bool Si5351Psk::start() {
+    if (_alarm >= 0) return true;
+    alarm_id_t id = add_alarm_in_us(1, _onAlarm, this, true);
+    if (id <= 0) return false;
+    _alarm = id;
+    return true;
+}
+
+void Si5351Psk::stop() {
+    if (_alarm > 0) cancel_alarm(_alarm);
+    _alarm = -1;
+    _running = false;
+}
+#endif
@@ -0,0 +1,95 @@
+#ifndef _SI5351_PSK_H_
+#define _SI5351_PSK_H_
+/*
+ * si5351_psk.h
+ *
+ * BPSK/QPSK modulation engine. The register images of the four carrier phases
+ * are built once from the driver state, and each symbol writes only what
+ * differs from the previous one:
+ *   0° <-> 180°   the CLKx_CTL inversion bit, a single register (two for VFO0)
+ *   90° / 270°    PHOFF plus a PLL reset, since a new phase offset only takes
+ *                 effect on reset (the other outputs of that PLL restart too)
+ *
+ * PSK31-style beacons use sendVaricode(): differential BPSK, a 0 bit reverses
+ * the phase, characters are separated by "00". Keying is hard (no amplitude
+ * shaping), so the spectrum is wider than a shaped PSK31 signal.
+ *
+ * Symbols are clocked from poll() in loop(), or on RP2040 by a hardware alarm
+ * after start(). Call begin() again after retuning, and do not use the driver
+ * from other code while symbols are being sent.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_PSK_BPSK     0 // Phases 0° and 180°
+#define SI_PSK_QPSK     1 // Phases 0°, 90°, 180° and 270°
+
+#define SI_PSK31_US     32000 // PSK31 symbol time (31.25 Bd)
+
+class Si5351Psk {
+public:
+    // Modulate one driver VFO (1 = CLK2; 0 = CLK0 and CLK1 together, keeping their quadrature)
+    explicit Si5351Psk(Si5351& vfo, uint8_t vfoIdx = 1)
+      : _vfo(vfo), _idx(vfoIdx) {}
+
+    // Build the symbol images from the current driver state, false if the mode is not possible
+    // (QPSK on VFO0 needs a MultiSynth divider up to 63 so both phase offsets fit)
+    bool begin(uint8_t mode = SI_PSK_BPSK, uint32_t symbolUs = SI_PSK31_US);
+
+    // Queue a symbol: carrier phase 0..3 = 0°, 90°, 180°, 270° (BPSK uses bit 1 only)
+    bool symbol(uint8_t phase);
+
+    // Queue text as PSK31 varicode, false if it did not fit completely
+    bool sendVaricode(const char* text);
+
+    // Queue phase reversals (PSK31 idle/preamble)
+    bool idle(uint16_t symbols);
+
+    // Send the next symbol; returns the us until the following one, 0 when the queue is empty
+    uint32_t step();
+
+    // Run step() when due, call it often from loop() when not using start()
+    void poll(uint32_t nowUs);
+
+#if defined(ARDUINO_ARCH_RP2040)
+    bool start();
+    void stop();
+#endif
+
+    // Back to the 0° image, i.e. the driver's own register state
+    void end();
+
+    bool busy() const { return _head != _tail || _running; }
+    uint32_t resets() const { return _resets; } // Symbols that needed a PLL reset
+
+private:
+    Si5351& _vfo;
+    uint8_t _idx;
+    uint8_t _mode = SI_PSK_BPSK;
+    uint32_t _symUs = SI_PSK31_US;
+
+    struct {
+        uint8_t ctl[2];   // CLKx_CTL (VFO0: CLK0, CLK1)
+        uint8_t phoff[2]; // CLKx_PHOFF (VFO0: CLK0, CLK1)
+    } _img[4];
+    uint8_t _cur = 0;     // Phase on the chip
+    uint8_t _enc = 0;     // Phase after the last queued symbol, for differential encoding
+
+    uint8_t _queue[256];  // Symbol ring, uint8_t indices wrap by themselves
+    volatile uint8_t _head = 0, _tail = 0;
+    volatile bool _running = false; // A symbol period is in progress
+    uint32_t _due = 0;
+    uint32_t _resets = 0;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    int32_t _alarm = -1;
+    static int64_t _onAlarm(int32_t id, void* user);
+#endif
+
+    void _apply(uint8_t phase); // Write the registers that differ from the current phase
+    bool _bits(uint16_t code);  // Queue varicode bits (MSB first) and the "00" separator
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "si5351_scan.h"
+
+/*
+ * si5351_scan.cpp
+ *
+ * Channel scan engine, see si5351_scan.h.
+ */
+
+// ============ Planning ============
+
+// Sorted by frequency, the dividers usable by a run of channels are [lo(first), hi(last)], since
+// both bounds of Si5351::dividerRange() fall with frequency. Each run is grown as far as that range holds an even divider
+// with the same R, which gives the fewest divider changes for the sweep.
+uint16_t Si5351Scan::plan(const uint32_t* freqHz, uint16_t n, si_scan_ch_t* out) {
+    uint32_t xtal = _vfo.getXtal();
+    _ch = out;
+    _n = 0;
+    _groups = 0;
+    _pos = 0;
+
+    // Insertion sort by frequency, unreachable channels are dropped
+    for (uint16_t i = 0; i < n; i++) {
+        vfo_t v = vfo_t();
+        if (!Si5351::plan(xtal, freqHz[i], v)) continue;
+        uint16_t j = _n++;
+        while (j > 0 && out[j - 1].vfo.freq > freqHz[i]) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j].vfo = v;
+        out[j].index = i;
+    }
+
+    uint16_t first = 0;
+    while (first < _n) {
+        uint32_t f0 = out[first].vfo.freq;
+        uint8_t ri, lo, hi;
+        Si5351::dividerRange(xtal, f0, ri, lo, hi); // Planned channels always have a range
+
+        uint16_t last = first + 1;
+        while (last < _n) {
+            uint8_t r, l, h;
+            if (!Si5351::dividerRange(xtal, out[last].vfo.freq, r, l, h) || r != ri || h < lo) break;
+            if (h < hi) hi = h;
+            last++;
+        }
+
+        // Prefer the divider closest to the usual VCO target inside the run's range
+        uint64_t msi = SI_VCO_TARGET / ((uint64_t)f0 * ri);
+        msi += msi & 1;
+        if (msi < lo) msi = lo;
+        if (msi > hi) msi = hi;
+        for (uint16_t i = first; i < last; i++) {
+            vfo_t v = vfo_t();
+            if (Si5351::planDivider(xtal, out[i].vfo.freq, ri, (uint8_t)msi, v)) out[i].vfo = v;
+        }
+        _groups++;
+        first = last;
+    }
+    return _n;
+}
+
+// ============ Scanning ============
+
+void Si5351Scan::_tune(uint32_t nowUs) {
+    vfo_t v = _ch[_pos].vfo;
+    const vfo_t& cur = _vfo.getVfo(_idx);
+    v.phase = cur.phase; // The scan only changes the frequency
+    bool reset = v.msi != cur.msi || v.ri != cur.ri;
+
+    if (!_vfo.setVfo(_idx, v)) { // The VFO takes no integer plans (VFO1 in fractional mode): stop
+        _failed++;
+        _state = IDLE;
+        return;
+    }
+    if (!_vfo.update(_idx)) { // Bus error: the LO is not on this channel, skip it at the next poll()
+        _failed++;
+        _due = nowUs;
+        _state = SKIP;
+        return;
+    }
+    _hop = nowUs;
+    _due = nowUs + _stepUs; // After a reset, lock is not polled before a plain hop would settle
+    _state = reset ? LOCK : SETTLE;
+    _visits++;
+    if (reset) _resets++;
+}
+
+void Si5351Scan::start(uint32_t nowUs) {
+    if (!_n) return;
+    _pos = 0;
+    _visits = 0;
+    _resets = 0;
+    _unlocked = 0;
+    _failed = 0;
+    _tune(nowUs);
+}
+
+void Si5351Scan::resume(uint32_t nowUs) {
+    if (_state != HOLD) return;
+    _next(nowUs);
+}
+
+void Si5351Scan::_next(uint32_t nowUs) {
+    _pos = (_pos + 1) % _n;
+    _tune(nowUs);
+}
+
+void Si5351Scan::poll(uint32_t nowUs) {
+    if (_state == IDLE || _state == HOLD || (int32_t)(nowUs - _due) < 0) return;
+    if (_state == SKIP) {
+        _next(nowUs);
+        return;
+    }
+
+    // After a PLL reset the LO is valid once LOL clears; the reset time is only a timeout
+    if (_state == LOCK && !_vfo.locked(_idx)) {
+        if (nowUs - _hop < _resetUs) return;
+        _unlocked++;
+        _next(nowUs);
+        return;
+    }
+
+    uint32_t dwell = _cb ? _cb(_ctx, _ch[_pos].index, _ch[_pos].vfo.freq) : 0;
+    if (dwell == SI_SCAN_HOLD) {
+        _state = HOLD;
+    } else if (dwell) {
+        _state = DWELL;
+        _due = nowUs + dwell;
+    } else {
+        _next(nowUs);
+    }
+}
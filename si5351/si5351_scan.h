@@ -0,0 +1,100 @@
+#ifndef _SI5351_SCAN_H_
+#define _SI5351_SCAN_H_
+/*
+ * si5351_scan.h
+ *
+ * Channel scan engine. plan() sorts the channel list by frequency and gives
+ * consecutive channels the same MultiSynth divider wherever the VCO range allows
+ * it, so most hops only change the PLL numerator (no PLL reset, short settling)
+ * and a divider change happens once per group instead of per channel.
+ *
+ * The measurement callback runs when the LO is valid on a channel; its return
+ * value sets the dwell, so empty channels are left at once and busy ones kept:
+ *   0              next channel
+ *   n              call again after n us on this channel
+ *   SI_SCAN_HOLD   stop here (resume() continues with the next channel)
+ *
+ * A numerator-only hop settles for a fixed time (the PLL slews and stays
+ * locked). After a divider change, which resets the PLL, poll() reads the lock
+ * status (Si5351::locked()) from the same time on and signals once the PLL has
+ * locked; a channel still unlocked after the reset timeout is skipped, see
+ * setSettle() and unlocked(). A hop whose bus write fails is skipped without a
+ * callback; if the VFO refuses the channel plan (VFO1 in fractional mode) the
+ * scan stops. Both count in failed(). Call poll() from loop(); the callback runs
+ * there too, so it may use the driver or an ADC.
+ *
+ */
+
+#include <Arduino.h>
+#include "si5351.h"
+
+#define SI_SCAN_HOLD        0xFFFFFFFFUL
+#define SI_SCAN_STEP_US     200  // Default settling after a numerator-only hop
+#define SI_SCAN_RESET_US    1500 // Default lock timeout after a divider change (PLL reset)
+
+// A planned channel
+typedef struct {
+    vfo_t    vfo;   // Dividers for the channel
+    uint16_t index; // Position in the caller's channel list
+} si_scan_ch_t;
+
+// Called when the LO is valid on a channel, returns the dwell (see above)
+typedef uint32_t (*si_scan_cb_t)(void* ctx, uint16_t index, uint32_t freqHz);
+
+class Si5351Scan {
+public:
+    Si5351Scan(Si5351& vfo, uint8_t vfoIdx = 0)
+      : _vfo(vfo), _idx(vfoIdx) {}
+
+    // Plan a channel list into caller storage (n entries); unreachable channels are dropped.
+    // Returns the number of planned channels.
+    uint16_t plan(const uint32_t* freqHz, uint16_t n, si_scan_ch_t* out);
+
+    // Divider changes in one pass over the planned list (PLL resets per sweep)
+    uint16_t groups() const { return _groups; }
+
+    // Settling after a numerator-only hop, and the longest wait for lock after a PLL reset
+    void setSettle(uint32_t stepUs, uint32_t resetUs) { _stepUs = stepUs; _resetUs = resetUs; }
+    void onValid(si_scan_cb_t cb, void* ctx = nullptr) { _cb = cb; _ctx = ctx; }
+
+    // Start with the first planned channel, stop, or continue after SI_SCAN_HOLD
+    void start(uint32_t nowUs);
+    void stop() { _state = IDLE; }
+    void resume(uint32_t nowUs);
+
+    void poll(uint32_t nowUs);
+
+    bool holding() const { return _state == HOLD; }
+    uint16_t current() const { return _n ? _ch[_pos].index : 0; } // Channel list index being scanned
+    uint32_t visits() const { return _visits; } // Channels tuned since start()
+    uint32_t resets() const { return _resets; } // Hops that needed a PLL reset
+    uint32_t unlocked() const { return _unlocked; } // Channels skipped, no lock within the timeout
+    uint32_t failed() const { return _failed; }     // Hops that did not reach the chip (see above)
+    bool running() const { return _state != IDLE; }
+
+private:
+    enum { IDLE, SETTLE, LOCK, DWELL, HOLD, SKIP };
+
+    Si5351& _vfo;
+    uint8_t _idx;
+    si_scan_ch_t* _ch = nullptr;
+    uint16_t _n = 0;
+    uint16_t _groups = 0;
+    uint16_t _pos = 0;
+    uint8_t _state = IDLE;
+    uint32_t _due = 0;
+    uint32_t _hop = 0; // Time of the last hop
+    uint32_t _stepUs = SI_SCAN_STEP_US;
+    uint32_t _resetUs = SI_SCAN_RESET_US;
+    si_scan_cb_t _cb = nullptr;
+    void* _ctx = nullptr;
+    uint32_t _visits = 0;
+    uint32_t _resets = 0;
+    uint32_t _unlocked = 0;
+    uint32_t _failed = 0;
+
+    void _tune(uint32_t nowUs); // Tune _pos and start settling, or skip or stop if that fails
+    void _next(uint32_t nowUs); // Go on with the next channel
+};
+
+#endif
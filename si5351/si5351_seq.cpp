@@ -0,0 +1,223 @@
+#include "si5351_seq.h"
+
+/*
+ * si5351_seq.cpp
+ *
+ * Timed register-program sequencer, see si5351_seq.h.
+ */
+
+#if defined(ARDUINO_ARCH_RP2040)
+#include <pico/time.h>
+#endif
+
+// ============ Virtual Machine ============
+
+Si5351Seq::Si5351Seq(Si5351& vfo)
+  : _writer(_driverWriter), _ctx(&vfo) {}
+
+void Si5351Seq::_driverWriter(void* ctx, uint8_t reg, const uint8_t* data, uint8_t len) {
+    static_cast<Si5351*>(ctx)->writeRegs(reg, data, len);
+}
+
+void Si5351Seq::load(const uint8_t* prog) {
+    _prog = prog;
+    _pc = prog;
+    _depth = 0;
+}
+
+bool Si5351Seq::load(const uint8_t* prog, uint16_t len) {
+    if (!check(prog, len)) return false;
+    load(prog);
+    return true;
+}
+
+bool Si5351Seq::check(const uint8_t* prog, uint16_t len) {
+    if (!prog) return false;
+    uint16_t i = 0;
+    uint8_t depth = 0;
+    while (i < len) {
+        uint8_t op = prog[i++];
+        uint16_t left = len - i;
+        switch (op) {
+            case SI_SEQ_END:
+                return true;
+            case SI_SEQ_WAIT:
+                if (left < 4) return false;
+                i += 4;
+                break;
+            case SI_SEQ_WRITE:
+                if (left < 2 || left - 2 < prog[i + 1]) return false;
+                if (!prog[i + 1] || prog[i] + prog[i + 1] > SI_REG_COUNT) return false;
+                i += 2 + prog[i + 1];
+                break;
+            case SI_SEQ_OE:
+            case SI_SEQ_RESET:
+                if (left < 1) return false;
+                i++;
+                break;
+            case SI_SEQ_REPEAT:
+                if (left < 1 || depth == SI_SEQ_DEPTH) return false;
+                depth++;
+                i++;
+                break;
+            case SI_SEQ_NEXT:
+                if (depth == 0) return false;
+                depth--;
+                break;
+            default:
+                return false;
+        }
+    }
+    return false; // Ran off the end without SI_SEQ_END
+}
+
+SI5351_HOT uint32_t Si5351Seq::step() {
+    while (_pc) {
+        uint8_t op = *_pc++;
+        switch (op) {
+            case SI_SEQ_WAIT: {
+                uint32_t us = (uint32_t)_pc[0] | ((uint32_t)_pc[1] << 8) |
+                              ((uint32_t)_pc[2] << 16) | ((uint32_t)_pc[3] << 24);
+                _pc += 4;
+                if (us) return us; // A zero wait is a no-op
+                break;
+            }
+            case SI_SEQ_WRITE:
+                if (!_pc[1] || _pc[0] + _pc[1] > SI_REG_COUNT) { _pc = nullptr; break; } // Bad run, stop
+                _writer(_ctx, _pc[0], &_pc[2], _pc[1]);
+                _pc += 2 + _pc[1];
+                break;
+            case SI_SEQ_OE:
+                _writer(_ctx, SI_CLK_OE, _pc, 1);
+                _pc++;
+                break;
+            case SI_SEQ_RESET:
+                _writer(_ctx, SI_PLL_RESET, _pc, 1);
+                _pc++;
+                break;
+            case SI_SEQ_REPEAT:
+                if (_depth == SI_SEQ_DEPTH) { _pc = nullptr; break; } // Nested too deep, stop
+                _loop[_depth].left = *_pc++;
+                _loop[_depth].start = _pc;
+                _depth++;
+                break;
+            case SI_SEQ_NEXT:
+                if (_depth == 0) break; // Unmatched, ignore
+                if (_loop[_depth - 1].left == 0 || --_loop[_depth - 1].left > 0) {
+                    _pc = _loop[_depth - 1].start; // Forever, or passes left
+                } else {
+                    _depth--;
+                }
+                break;
+            default: // SI_SEQ_END or an unknown opcode
+                _pc = nullptr;
+                break;
+        }
+    }
+    return 0;
+}
+
+uint32_t Si5351Seq::simulate(uint32_t maxUs) {
+    _simTime = 0;
+    while (running() && _simTime <= maxUs) {
+        uint32_t wait = step();
+        if (!wait) break;
+        _simTime += wait;
+    }
+    return _simTime;
+}
+
+// ============ RP2040 Alarm Runner ============
+
+#if defined(ARDUINO_ARCH_RP2040)
+// Alarm callback: run events, then ask the SDK to fire again relative to this event's target time
+int64_t Si5351Seq::_onAlarm(int32_t id, void* user) {
+    (void)id;
+    Si5351Seq* seq = static_cast<Si5351Seq*>(user);
+    uint32_t wait = seq->step();
+    if (!wait) seq->_alarm = -1;
+    return wait; // > 0 reschedules from the previous target, so waits do not accumulate drift
+}
+
+bool Si5351Seq::start(uint32_t delayUs) {
+    if (!_prog) return false;
+    stop();
+    load(_prog);
+    alarm_id_t id = add_alarm_in_us(delayUs, _onAlarm, this, true);
+    if (id <= 0) return false; // No free alarm slot, or already fired and ended
+    _alarm = id;
+    return true;
+}
+
+void Si5351Seq::stop() {
+    if (_alarm > 0) cancel_alarm(_alarm);
+    _alarm = -1;
+    _pc = nullptr;
+}
+#endif
+
+// ============ Program Builder ============
+
+void Si5351SeqBuilder::_put(uint8_t b) {
+    if (_len < _size) _buf[_len++] = b;
+    else _ok = false;
+}
+
+Si5351SeqBuilder& Si5351SeqBuilder::wait(uint32_t us) {
+    _put(SI_SEQ_WAIT);
+    _put(us & 0xFF);
+    _put((us >> 8) & 0xFF);
+    _put((us >> 16) & 0xFF);
+    _put((us >> 24) & 0xFF);
+    return *this;
+}
+
+Si5351SeqBuilder& Si5351SeqBuilder::write(uint8_t reg, const uint8_t* data, uint8_t len) {
+    if (!len || reg + len > SI_REG_COUNT) { // The VM would stop there
+        _ok = false;
+        return *this;
+    }
+    _put(SI_SEQ_WRITE);
+    _put(reg);
+    _put(len);
+    for (uint8_t i = 0; i < len; i++) _put(data[i]);
+    return *this;
+}
+
+Si5351SeqBuilder& Si5351SeqBuilder::outputs(uint8_t oeMask) { _put(SI_SEQ_OE); _put(oeMask); return *this; }
+Si5351SeqBuilder& Si5351SeqBuilder::reset(uint8_t mask) { _put(SI_SEQ_RESET); _put(mask); return *this; }
+Si5351SeqBuilder& Si5351SeqBuilder::repeat(uint8_t count) { _put(SI_SEQ_REPEAT); _put(count); return *this; }
+Si5351SeqBuilder& Si5351SeqBuilder::next() { _put(SI_SEQ_NEXT); return *this; }
+Si5351SeqBuilder& Si5351SeqBuilder::end() { _put(SI_SEQ_END); return *this; }
+
+// Same register layout as Si5351::update(): VFO0 = PLLA + MS0/MS1, VFO1 = PLLB + MS2
+Si5351SeqBuilder& Si5351SeqBuilder::freq(uint8_t vfoIdx, uint32_t freqHz, uint8_t phase) {
+    vfo_t v = vfo_t();
+    if (vfoIdx > 1 || !Si5351::plan(_xtal, freqHz, v)) {
+        _ok = false;
+        return *this;
+    }
+
+    uint8_t img[16];
+    Si5351::encodeMSN(img, v.msna, v.msnb, SI_PLL_C);
+    write(vfoIdx == 0 ? SI_SYNTH_PLLA : SI_SYNTH_PLLB, img, 8);
+
+    if (v.msi != _msi[vfoIdx] || v.ri != _ri[vfoIdx] || phase != _phase[vfoIdx]) {
+        uint8_t rcode = 0;
+        while ((1 << rcode) < v.ri) rcode++;
+        Si5351::encodeMSI(img, v.msi, rcode);
+        if (vfoIdx == 0) {
+            for (uint8_t i = 0; i < 8; i++) img[8 + i] = img[i]; // CLK1 uses the same divider
+            write(SI_SYNTH_MS0, img, 16);
+            uint8_t phoff[2] = {0, (uint8_t)((phase == PH090 || phase == PH270) ? v.msi : 0)};
+            write(SI_CLK0_PHOFF, phoff, 2);
+        } else {
+            write(SI_SYNTH_MS2, img, 8);
+        }
+        reset(vfoIdx == 0 ? SI_PLL_RESET_A : SI_PLL_RESET_B);
+        _msi[vfoIdx] = v.msi;
+        _ri[vfoIdx] = v.ri;
+        _phase[vfoIdx] = phase;
+    }
+    return *this;
+}
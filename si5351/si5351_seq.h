@@ -0,0 +1,135 @@
+#ifndef _SI5351_SEQ_H_
+#define _SI5351_SEQ_H_
+/*
+ * si5351_seq.h
+ *
+ * Timed register-program sequencer: a tiny bytecode VM that plays precompiled
+ * register writes (beacons, band scans, keyed sequences) with microsecond timing.
+ * On RP2040 it runs from a hardware alarm, so the CPU is not involved between events.
+ *
+ * Program format (bytes, usually a const array in flash):
+ *   SI_SEQ_END                      stop
+ *   SI_SEQ_WAIT   us(u32 LE)        next event this long after the previous one (no drift)
+ *   SI_SEQ_WRITE  reg len data[len] register burst, e.g. a pre-encoded frequency image;
+ *                                   1..255 registers below SI_REG_COUNT, else the program stops
+ *   SI_SEQ_OE     mask              output enable register (bit set = output disabled)
+ *   SI_SEQ_RESET  mask              PLL reset (SI_PLL_RESET_A / SI_PLL_RESET_B)
+ *   SI_SEQ_REPEAT count             repeat up to the matching SI_SEQ_NEXT, 0 = forever
+ *   SI_SEQ_NEXT                     end of a repeated block
+ *
+ * Si5351SeqBuilder compiles frequencies into pre-encoded images, and simulate()
+ * runs a program against a virtual clock, so sequences can be checked on the host.
+ * While a sequence runs from the alarm, do not use the driver from other code.
+ *
+ */
+
+#include "si5351.h"
+
+#define SI_SEQ_END       0x00
+#define SI_SEQ_WAIT      0x01
+#define SI_SEQ_WRITE     0x02
+#define SI_SEQ_OE        0x03
+#define SI_SEQ_RESET     0x04
+#define SI_SEQ_REPEAT    0x05
+#define SI_SEQ_NEXT      0x06
+
+#define SI_SEQ_DEPTH     4 // Maximum nesting of repeated blocks
+
+// Register writer used by the VM; ctx is passed through unchanged
+typedef void (*si_seq_writer_t)(void* ctx, uint8_t reg, const uint8_t* data, uint8_t len);
+
+class Si5351Seq {
+public:
+    // Writes go to the driver (its register mirror stays in sync)
+    explicit Si5351Seq(Si5351& vfo);
+
+    // Writes go to a custom writer, e.g. a recorder in a host simulation
+    Si5351Seq(si_seq_writer_t writer, void* ctx)
+      : _writer(writer), _ctx(ctx) {}
+
+    // Select the program and rewind it
+    void load(const uint8_t* prog);
+
+    // Same, for a program of len bytes from outside the firmware (flash image, serial link):
+    // false and nothing loaded if check() rejects it
+    bool load(const uint8_t* prog, uint16_t len);
+
+    // True if prog ends with SI_SEQ_END inside len bytes, every operand fits, every write stays
+    // below SI_REG_COUNT and repeated blocks nest at most SI_SEQ_DEPTH deep with no stray SI_SEQ_NEXT
+    static bool check(const uint8_t* prog, uint16_t len);
+
+    // Execute until the next wait; returns the wait in us, or 0 when the program has ended
+    uint32_t step();
+
+    bool running() const { return _pc != nullptr; }
+
+    // Run the program against a virtual clock for at most maxUs, returns the virtual end time.
+    // simTime() gives the virtual time inside the writer.
+    uint32_t simulate(uint32_t maxUs);
+    uint32_t simTime() const { return _simTime; }
+
+#if defined(ARDUINO_ARCH_RP2040)
+    // Run the loaded program from a hardware alarm, first event after delayUs
+    bool start(uint32_t delayUs = 0);
+    void stop();
+#endif
+
+private:
+    si_seq_writer_t _writer;
+    void* _ctx;
+    const uint8_t* _prog = nullptr; // Loaded program
+    const uint8_t* _pc = nullptr;   // Next opcode, null when stopped
+    uint32_t _simTime = 0;
+
+    struct {
+        const uint8_t* start; // First opcode of the block
+        uint8_t left;         // Remaining passes, 0 = forever
+    } _loop[SI_SEQ_DEPTH];
+    uint8_t _depth = 0;
+
+#if defined(ARDUINO_ARCH_RP2040)
+    int32_t _alarm = -1; // Alarm id while running
+    static int64_t _onAlarm(int32_t id, void* user);
+#endif
+
+    static void _driverWriter(void* ctx, uint8_t reg, const uint8_t* data, uint8_t len);
+};
+
+// Compiles sequence programs into a caller-provided buffer
+class Si5351SeqBuilder {
+public:
+    // xtalHz must match the crystal the driver was constructed with
+    Si5351SeqBuilder(uint8_t* buf, uint16_t size, uint32_t xtalHz = 25000000UL)
+      : _buf(buf), _size(size), _xtal(xtalHz) {}
+
+    Si5351SeqBuilder& wait(uint32_t us);
+    Si5351SeqBuilder& write(uint8_t reg, const uint8_t* data, uint8_t len);
+    Si5351SeqBuilder& outputs(uint8_t oeMask);  // SI_SEQ_OE, bit set = output disabled
+    Si5351SeqBuilder& reset(uint8_t mask);
+    Si5351SeqBuilder& repeat(uint8_t count);    // 0 = forever
+    Si5351SeqBuilder& next();
+    Si5351SeqBuilder& end();
+
+    // Pre-encode a VFO frequency: PLL image, plus MultiSynth image(s), VFO0 phase offset and a PLL
+    // reset only when the divider or phase differs from the previous freq() of that VFO. The CLK1
+    // inversion for 180°/270° is not written, it stays as configured through the driver.
+    Si5351SeqBuilder& freq(uint8_t vfoIdx, uint32_t freqHz, uint8_t phase = PH000);
+
+    uint16_t size() const { return _len; }  // Program bytes so far
+    bool ok() const { return _ok; }         // False if the buffer overflowed, a write ran past the
+                                            // register map or a frequency failed
+
+private:
+    uint8_t* _buf;
+    uint16_t _size;
+    uint32_t _xtal;
+    uint16_t _len = 0;
+    bool _ok = true;
+    uint8_t _msi[2] = {};  // Divider of the last freq() per VFO, 0 = none yet
+    uint8_t _ri[2] = {};
+    uint8_t _phase[2] = {};
+
+    void _put(uint8_t b);
+};
+
+#endif
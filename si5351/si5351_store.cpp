@@ -0,0 +1,219 @@
+#include "si5351_store.h"
+
+/*
+ * si5351_store.cpp
+ *
+ * Preset and calibration image, see si5351_store.h.
+ */
+
+static inline void put16(uint8_t* p, uint16_t v) { p[0] = v & 0xFF; p[1] = v >> 8; }
+static inline void put32(uint8_t* p, uint32_t v) { put16(p, v & 0xFFFF); put16(p + 2, v >> 16); }
+static inline uint16_t get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+static inline uint32_t get32(const uint8_t* p) { return get16(p) | ((uint32_t)get16(p + 2) << 16); }
+
+uint16_t si5351Crc16(uint16_t crc, const uint8_t* data, uint16_t len) {
+    while (len--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// ============ Writer ============
+
+uint8_t* Si5351StoreWriter::_record(uint8_t type, uint16_t len) {
+    if (!_ok || (uint32_t)_len + SI_STORE_REC_HEADER + len > _size) {
+        _ok = false;
+        return nullptr;
+    }
+    uint8_t* p = &_buf[_len];
+    p[0] = type;
+    put16(&p[1], len);
+    _len += SI_STORE_REC_HEADER + len;
+    _count++;
+    return p + SI_STORE_REC_HEADER;
+}
+
+bool Si5351StoreWriter::addXtal(uint32_t xtalHz) {
+    uint8_t* p = _record(SI_REC_XTAL, 4);
+    if (!p) return false;
+    put32(p, xtalHz);
+    return true;
+}
+
+bool Si5351StoreWriter::addCalibration(const int8_t* tempC, const uint32_t* xtalHz, uint8_t n) {
+    uint8_t* p = _record(SI_REC_CAL, 5 * n);
+    if (!p) return false;
+    for (uint8_t i = 0; i < n; i++, p += 5) {
+        p[0] = (uint8_t)tempC[i];
+        put32(&p[1], xtalHz[i]);
+    }
+    return true;
+}
+
+bool Si5351StoreWriter::addVfo(uint8_t vfoIdx, const vfo_t& v, bool en) {
+    uint8_t* p = _record(SI_REC_VFO, SI_REC_VFO_LEN);
+    if (!p) return false;
+    p[0] = vfoIdx;
+    p[1] = en;
+    p[2] = v.phase;
+    p[3] = v.ri;
+    p[4] = v.msi;
+    p[5] = (uint8_t)v.msna;
+    put32(&p[6], v.freq);
+    put32(&p[10], v.msnb);
+    return true;
+}
+
+bool Si5351StoreWriter::addChannels(uint8_t bank, const uint32_t* freqHz, uint16_t n) {
+    uint8_t* p = _record(SI_REC_CHANNELS, 1 + 4 * n);
+    if (!p) return false;
+    p[0] = bank;
+    for (uint16_t i = 0; i < n; i++) put32(&p[1 + 4 * i], freqHz[i]);
+    return true;
+}
+
+bool Si5351StoreWriter::addRegs(uint8_t reg, const uint8_t* data, uint8_t len) {
+    if (!len || reg + len > SI_REG_COUNT) {
+        _ok = false;
+        return false;
+    }
+    uint8_t* p = _record(SI_REC_REGS, 1 + len);
+    if (!p) return false;
+    p[0] = reg;
+    for (uint8_t i = 0; i < len; i++) p[1 + i] = data[i];
+    return true;
+}
+
+bool Si5351StoreWriter::addState(const Si5351& vfo) {
+    bool ok = addXtal(vfo.getXtal());
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) {
+        ok = ok && addVfo(i, vfo.getVfo(i), vfo.isEnabled(i));
+    }
+    return ok;
+}
+
+uint16_t Si5351StoreWriter::finish() {
+    if (!_ok || _size < SI_STORE_HEADER) return 0;
+    uint16_t len = _len - SI_STORE_HEADER;
+    _buf[0] = SI_STORE_MAGIC0;
+    _buf[1] = SI_STORE_MAGIC1;
+    _buf[2] = SI_STORE_VERSION;
+    _buf[3] = 0; // Flags, reserved
+    put16(&_buf[4], len);
+    put16(&_buf[6], _count);
+    put16(&_buf[8], si5351Crc16(0xFFFF, &_buf[SI_STORE_HEADER], len));
+    return _len;
+}
+
+// ============ Reader ============
+
+bool Si5351StoreReader::valid() const {
+    if (_size < SI_STORE_HEADER) return false;
+    if (_img[0] != SI_STORE_MAGIC0 || _img[1] != SI_STORE_MAGIC1 || _img[2] != SI_STORE_VERSION) return false;
+    uint16_t len = get16(&_img[4]);
+    if ((uint32_t)SI_STORE_HEADER + len > _size) return false; // Truncated (or erased flash)
+    return si5351Crc16(0xFFFF, &_img[SI_STORE_HEADER], len) == get16(&_img[8]);
+}
+
+bool Si5351StoreReader::next(si_record_t& rec) {
+    uint16_t end = SI_STORE_HEADER + get16(&_img[4]);
+    if (_index >= get16(&_img[6]) || _pos + SI_STORE_REC_HEADER > end) return false;
+    rec.type = _img[_pos];
+    rec.len = get16(&_img[_pos + 1]);
+    rec.data = &_img[_pos + SI_STORE_REC_HEADER];
+    if ((uint32_t)_pos + SI_STORE_REC_HEADER + rec.len > end) return false; // Corrupt length
+    _pos += SI_STORE_REC_HEADER + rec.len;
+    _index++;
+    return true;
+}
+
+bool Si5351StoreReader::find(uint8_t type, si_record_t& rec) {
+    rewind();
+    while (next(rec)) {
+        if (rec.type == type) return true;
+    }
+    return false;
+}
+
+uint32_t Si5351StoreReader::calibratedXtal(int8_t tempC) {
+    si_record_t rec;
+    if (!find(SI_REC_CAL, rec) || rec.len < 5) return 0;
+    uint8_t n = rec.len / 5;
+    const uint8_t* p = rec.data;
+    if (tempC <= (int8_t)p[0] || n == 1) return get32(&p[1]); // Below the table, clamp
+    for (uint8_t i = 1; i < n; i++) {
+        int8_t t0 = (int8_t)p[5 * (i - 1)], t1 = (int8_t)p[5 * i];
+        if (tempC > t1) continue;
+        int32_t x0 = (int32_t)get32(&p[5 * (i - 1) + 1]), x1 = (int32_t)get32(&p[5 * i + 1]);
+        return (uint32_t)(x0 + (int32_t)((int64_t)(x1 - x0) * (tempC - t0) / (t1 - t0)));
+    }
+    return get32(&p[5 * (n - 1) + 1]); // Above the table, clamp
+}
+
+uint32_t Si5351StoreReader::channel(uint8_t bank, uint16_t idx) {
+    si_record_t rec;
+    rewind();
+    while (next(rec)) {
+        if (rec.type != SI_REC_CHANNELS || rec.len < 1 || rec.data[0] != bank) continue;
+        if (idx < (rec.len - 1) / 4) return get32(&rec.data[1 + 4 * idx]);
+        idx -= (rec.len - 1) / 4; // A bank may continue in the next record
+    }
+    return 0;
+}
+
+bool Si5351StoreReader::validRegs(const si_record_t& rec) {
+    if (rec.type != SI_REC_REGS || rec.len < 2 || rec.len > 256) return false;
+    return rec.data[0] + rec.len - 1 <= SI_REG_COUNT;
+}
+
+bool Si5351StoreReader::decodeVfo(const si_record_t& rec, uint8_t& vfoIdx, vfo_t& v, bool& en) {
+    if (rec.type != SI_REC_VFO || rec.len < SI_REC_VFO_LEN) return false;
+    const uint8_t* p = rec.data;
+    vfoIdx = p[0];
+    en = p[1] != 0;
+    v = vfo_t();
+    v.phase = p[2];
+    v.ri = p[3];
+    v.msi = p[4];
+    v.msna = p[5];
+    v.freq = get32(&p[6]);
+    v.msnb = get32(&p[10]);
+    return true;
+}
+
+// Stored dividers were planned for the stored crystal, so the crystal is set before begin()
+bool Si5351StoreReader::restore(Si5351& vfo) {
+    if (!valid()) return false;
+
+    si_record_t rec;
+    rewind();
+    while (next(rec)) { // Refuse the whole image before touching the chip
+        if (rec.type == SI_REC_REGS && !validRegs(rec)) return false;
+    }
+    if (find(SI_REC_XTAL, rec) && rec.len >= 4) vfo.setXtal(get32(rec.data));
+
+    vfo_t init[SI5351_VFO_COUNT] = {}; // Entries left empty fall back to the defaults in begin()
+    uint8_t en = 0;
+    rewind();
+    while (next(rec)) {
+        uint8_t idx;
+        vfo_t v;
+        bool on;
+        if (!decodeVfo(rec, idx, v, on) || idx >= SI5351_VFO_COUNT) continue;
+        init[idx] = v;
+        if (on) en |= 1 << idx;
+    }
+    if (!vfo.begin(init)) return false;
+
+    bool ok = true;
+    for (uint8_t i = 0; i < SI5351_VFO_COUNT; i++) ok &= vfo.enable(i, en & (1 << i));
+
+    rewind();
+    while (next(rec)) {
+        if (rec.type == SI_REC_REGS) ok &= vfo.writeRegs(rec.data[0], &rec.data[1], (uint8_t)(rec.len - 1));
+    }
+    return ok;
+}
@@ -0,0 +1,116 @@
+#ifndef _SI5351_STORE_H_
+#define _SI5351_STORE_H_
+/*
+ * si5351_store.h
+ *
+ * Versioned, CRC-protected binary image for presets and calibration: VFO states
+ * (with their planned dividers), channel banks, crystal calibration tables and
+ * encoded register images.
+ *
+ * The writer fills a caller buffer (e.g. a 4 KB flash sector image in RAM), the
+ * reader works in place on any memory, including a sector read through XIP, so
+ * nothing is copied at boot. Restoring VFO states skips the planner entirely.
+ *
+ * Layout (little endian):
+ *   header  magic "S5"(2) version(1) flags(1) length(2) count(2) crc16(2)
+ *   records type(1) length(2) data[length], "count" of them, "length" bytes in total
+ * CRC-16/CCITT (poly 0x1021, init 0xFFFF) covers the records. Unknown record
+ * types are skipped, so newer images stay readable as long as the version matches.
+ *
+ */
+
+#include "si5351.h"
+
+#define SI_STORE_MAGIC0     'S'
+#define SI_STORE_MAGIC1     '5'
+#define SI_STORE_VERSION    1
+#define SI_STORE_HEADER     10 // Header bytes
+#define SI_STORE_REC_HEADER 3  // Record type and length bytes
+
+// Record types
+#define SI_REC_XTAL         1 // xtal u32: calibrated crystal frequency in Hz
+#define SI_REC_CAL          2 // {temp s8, xtal u32} x n: crystal frequency over temperature, sorted by temp
+#define SI_REC_VFO          3 // vfo u8, en u8, phase u8, ri u8, msi u8, msna u8, freq u32, msnb u32
+#define SI_REC_CHANNELS     4 // bank u8, freq u32 x n: channel bank
+#define SI_REC_REGS         5 // reg u8, data[n]: encoded register image, 1..255 bytes within the register map
+
+#define SI_REC_VFO_LEN      14
+
+// A record, pointing into the image
+typedef struct {
+    uint8_t type;
+    uint16_t len;
+    const uint8_t* data;
+} si_record_t;
+
+class Si5351StoreWriter {
+public:
+    Si5351StoreWriter(uint8_t* buf, uint16_t size)
+      : _buf(buf), _size(size) {}
+
+    bool addXtal(uint32_t xtalHz);
+    bool addCalibration(const int8_t* tempC, const uint32_t* xtalHz, uint8_t n);
+    bool addVfo(uint8_t vfoIdx, const vfo_t& v, bool en);
+    bool addChannels(uint8_t bank, const uint32_t* freqHz, uint16_t n);
+    // Registers reg..reg+len-1, which must lie below SI_REG_COUNT; an image with a bad run does not finish
+    bool addRegs(uint8_t reg, const uint8_t* data, uint8_t len);
+
+    // Crystal, all VFOs with their dividers and output states
+    bool addState(const Si5351& vfo);
+
+    // Fill in the header, returns the total image size (0 if something did not fit or was invalid)
+    uint16_t finish();
+
+private:
+    uint8_t* _buf;
+    uint16_t _size;
+    uint16_t _len = SI_STORE_HEADER; // Bytes used, header included
+    uint16_t _count = 0;
+    bool _ok = true;
+
+    uint8_t* _record(uint8_t type, uint16_t len); // Reserve a record, null if it does not fit
+};
+
+class Si5351StoreReader {
+public:
+    Si5351StoreReader(const uint8_t* image, uint16_t size)
+      : _img(image), _size(size) {}
+
+    // Magic, version, length and CRC check
+    bool valid() const;
+
+    // Iterate over the records, rewind() to start again
+    bool next(si_record_t& rec);
+    void rewind() { _pos = SI_STORE_HEADER; _index = 0; }
+
+    // First record of a type, false if there is none
+    bool find(uint8_t type, si_record_t& rec);
+
+    // Crystal frequency for a temperature, linearly interpolated from SI_REC_CAL (0 if absent)
+    uint32_t calibratedXtal(int8_t tempC);
+
+    // Channel of a bank (0 if absent)
+    uint32_t channel(uint8_t bank, uint16_t idx);
+
+    // Apply crystal, VFO states (without planning), output states and register images,
+    // starting the driver with begin(). False if the image is invalid (nothing is written then,
+    // a register image outside the map included) or a register write failed.
+    bool restore(Si5351& vfo);
+
+    // A SI_REC_REGS record that writeRegs() can take: 1..255 registers below SI_REG_COUNT
+    static bool validRegs(const si_record_t& rec);
+
+    // Decode a SI_REC_VFO record
+    static bool decodeVfo(const si_record_t& rec, uint8_t& vfoIdx, vfo_t& v, bool& en);
+
+private:
+    const uint8_t* _img;
+    uint16_t _size;
+    uint16_t _pos = SI_STORE_HEADER;
+    uint16_t _index = 0;
+};
+
+// CRC-16/CCITT, continuing from crc (start with 0xFFFF)
+uint16_t si5351Crc16(uint16_t crc, const uint8_t* data, uint16_t len);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _HOST_WIRE_H_
+#define _HOST_WIRE_H_
+/*
+ * Wire.h (host)
+ *
+ * A TwoWire with no device on the bus: every transfer is not acknowledged. Tests
+ * hand the driver a mock Si5351Bus instead.
+ *
+ */
+
+#include <Arduino.h>
+
+class TwoWire : public Stream {
+public:
+    void begin() {}
+    void setClock(uint32_t hz) { (void)hz; }
+    void beginTransmission(uint8_t addr) { (void)addr; }
+    uint8_t endTransmission(bool stop = true) { (void)stop; return 2; } // Address NACK
+    uint8_t requestFrom(uint8_t addr, uint8_t len) { (void)addr; (void)len; return 0; }
+    size_t write(uint8_t c) override { (void)c; return 1; }
+    using Print::write;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _HOST_CHECK_H_
+#define _HOST_CHECK_H_
+/*
+ * check.h
+ *
+ * Minimal assertions for the host tests: a failed check prints its location and
+ * the test keeps going, checkResult() gives the exit code.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+static unsigned checkFailures = 0;
+static unsigned checkCount = 0;
+
+#define CHECK(cond) \
+    do { \
+        checkCount++; \
+        if (!(cond)) { \
+            checkFailures++; \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        checkCount++; \
+        unsigned long long va = (unsigned long long)(a), vb = (unsigned long long)(b); \
+        if (va != vb) { \
+            checkFailures++; \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s = %llu, %s = %llu\n", __FILE__, __LINE__, #a, va, #b, vb); \
+        } \
+    } while (0)
+
+// Compare byte images, printing both on a mismatch
+#define CHECK_BYTES(got, want, n) \
+    do { \
+        checkCount++; \
+        if (memcmp((got), (want), (n)) != 0) { \
+            checkFailures++; \
+            fprintf(stderr, "%s:%d: CHECK_BYTES failed: %s\n  got: ", __FILE__, __LINE__, #got); \
+            for (unsigned i_ = 0; i_ < (unsigned)(n); i_++) fprintf(stderr, "%02X ", (got)[i_]); \
+            fprintf(stderr, "\n want: "); \
+            for (unsigned i_ = 0; i_ < (unsigned)(n); i_++) fprintf(stderr, "%02X ", (want)[i_]); \
+            fprintf(stderr, "\n"); \
+        } \
+    } while (0)
+
+static inline int checkResult(const char* name) {
+    fprintf(stderr, "%s: %u checks, %u failed\n", name, checkCount, checkFailures);
+    return checkFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#include <Arduino.h>
+#include <Wire.h>
+#include <stdio.h>
+
+/*
+ * host.cpp
+ *
+ * Host implementation of the Arduino functions in test/host/Arduino.h.
+ */
+
+TwoWire Wire;
+
+static unsigned long now;
+
+unsigned long micros() { return ++now; }
+unsigned long millis() { return now / 1000; }
+void delay(unsigned long ms) { now += ms * 1000; }
+void delayMicroseconds(unsigned int us) { now += us; }
+void hostAdvance(unsigned long us) { now += us; }
+
+size_t Print::write(const uint8_t* buf, size_t n) {
+    size_t done = 0;
+    while (n--) done += write(*buf++);
+    return done;
+}
+
+size_t Print::print(long v, int base) {
+    if (base == DEC) {
+        char s[24];
+        snprintf(s, sizeof(s), "%ld", v);
+        return write(s);
+    }
+    return print((unsigned long)v, base);
+}
+
+size_t Print::print(unsigned long v, int base) {
+    char s[24];
+    snprintf(s, sizeof(s), base == HEX ? "%lX" : "%lu", v);
+    return write(s);
+}
+
+size_t Print::print(double v, int digits) {
+    char s[40];
+    snprintf(s, sizeof(s), "%.*f", digits, v);
+    return write(s);
+}
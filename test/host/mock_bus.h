@@ -0,0 +1,53 @@
+#ifndef _HOST_MOCK_BUS_H_
+#define _HOST_MOCK_BUS_H_
+/*
+ * mock_bus.h
+ *
+ * Si5351Bus that plays a Si5351 register file: writes land in regs[] starting
+ * at the head byte, reads come from it. Register 0 (status) reads as status.
+ * Writes can be capped in length (maxBytes, head included) or failed on
+ * purpose (fail), like a NACK; a failed write changes nothing. limit is what
+ * maxWrite() reports to the driver.
+ *
+ */
+
+#include <string.h>
+#include "si5351_bus.h"
+
+class MockBus : public Si5351Bus {
+public:
+    uint8_t regs[256] = {};
+    uint8_t status = 0;       // Register 0 as read back
+    uint16_t maxBytes = 0;    // Longest write accepted, head included; 0 = any
+    uint16_t limit = 0;       // maxWrite(), head included; 0 = no limit
+    uint16_t fail = 0;        // Writes still to fail
+    uint32_t writes = 0;      // Writes accepted
+    uint32_t rejected = 0;    // Writes failed
+    uint16_t longest = 0;     // Longest write seen, head included
+
+    uint16_t maxWrite() const override { return limit ? limit : 0xFFFF; }
+
+    bool write(uint8_t addr, const uint8_t* head, uint8_t headLen, const uint8_t* data, uint16_t len) override {
+        uint16_t total = headLen + len;
+        if (total > longest) longest = total;
+        if (addr != 0x60 || headLen != 1 || fail || (maxBytes && total > maxBytes)) {
+            if (fail) fail--;
+            rejected++;
+            return false;
+        }
+        for (uint16_t i = 0; i < len; i++) regs[(uint8_t)(head[0] + i)] = data[i];
+        writes++;
+        return true;
+    }
+
+    bool read(uint8_t addr, const uint8_t* head, uint8_t headLen, uint8_t* data, uint16_t len) override {
+        if (addr != 0x60 || headLen != 1) return false;
+        for (uint16_t i = 0; i < len; i++) {
+            uint8_t r = head[0] + i;
+            data[i] = r == 0 ? status : regs[r];
+        }
+        return true;
+    }
+};
+
+#endif
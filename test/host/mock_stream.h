@@ -0,0 +1,49 @@
+#ifndef _HOST_MOCK_STREAM_H_
+#define _HOST_MOCK_STREAM_H_
+/*
+ * mock_stream.h
+ *
+ * Stream that plays a serial port: feed() queues bytes for read(), and what
+ * the code under test writes collects in out[] (outLen bytes). take() hands
+ * the output over and clears it.
+ *
+ */
+
+#include <string.h>
+#include <Arduino.h>
+
+class MockStream : public Stream {
+public:
+    uint8_t in[1024];
+    uint16_t inHead = 0, inLen = 0; // Next byte to read, bytes queued
+    uint8_t out[1024];
+    uint16_t outLen = 0;
+
+    void feed(const uint8_t* data, uint16_t n) {
+        if (inHead == inLen) inHead = inLen = 0;
+        for (uint16_t i = 0; i < n && inLen < sizeof(in); i++) in[inLen++] = data[i];
+    }
+    void feed(const char* s) { feed((const uint8_t*)s, strlen(s)); }
+
+    // Output so far as a string, cleared afterwards
+    const char* take() {
+        static char s[sizeof(out) + 1];
+        memcpy(s, out, outLen);
+        s[outLen] = '\0';
+        outLen = 0;
+        return s;
+    }
+
+    int available() override { return inLen - inHead; }
+    int read() override { return inHead < inLen ? in[inHead++] : -1; }
+    int peek() override { return inHead < inLen ? in[inHead] : -1; }
+
+    size_t write(uint8_t c) override {
+        if (outLen == sizeof(out)) return 0;
+        out[outLen++] = c;
+        return 1;
+    }
+    using Print::write;
+};
+
+#endif
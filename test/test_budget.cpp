@@ -0,0 +1,113 @@
+/*
+ * test_budget.cpp
+ *
+ * Bus traffic budgets from stats(), against a mock Si5351 on a 25 MHz crystal.
+ * A change that makes any of these operations send more fails the test; one
+ * that sends less still passes (then tighten the budget here and in README).
+ * Preset recalls count the same through the bus and through the DMA bookkeeping.
+ */
+
+#include "si5351.h"
+#include "check.h"
+#include "mock_bus.h"
+#include "si5351_bank.h"
+
+typedef struct {
+    uint32_t transactions, bytes, resets;
+} budget_t;
+
+static void checkBudget(const char* what, const si_stats_t& s, const budget_t& b) {
+    bool ok = s.transactions <= b.transactions && s.bytes <= b.bytes && s.resets <= b.resets && !s.errors;
+    CHECK(ok);
+    if (!ok) {
+        fprintf(stderr, "  %s: %lu transactions, %lu bytes, %lu resets (budget %lu, %lu, %lu)\n", what,
+                (unsigned long)s.transactions, (unsigned long)s.bytes, (unsigned long)s.resets,
+                (unsigned long)b.transactions, (unsigned long)b.bytes, (unsigned long)b.resets);
+    }
+}
+
+int main() {
+    static const budget_t beginBudget = {7, 56, 1};
+    static const budget_t stepBudget = {1, 3, 0};  // 10 Hz, same divider: PLL numerator low bytes
+    static const budget_t bandBudget = {5, 14, 1}; // New divider: PLL, MS0/MS1, PHOFF and a reset
+    static const budget_t anyBandBudget = {5, 16, 1}; // Also new R divider bits in the MS registers
+    static const budget_t noBudget = {0, 0, 0};
+    static const uint32_t sweepBytes = 10; // Worst 10 Hz step, numerator carries into higher bytes
+
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    vfo.begin();
+    checkBudget("begin()", vfo.stats(), beginBudget);
+
+    vfo.clearStats();
+    vfo.setFreq(0, 7074010UL);
+    vfo.update(0);
+    checkBudget("10 Hz step", vfo.stats(), stepBudget);
+
+    vfo.clearStats();
+    vfo.update(0);
+    checkBudget("update() without a change", vfo.stats(), noBudget);
+
+    // A 10 Hz sweep across the FT8/CW segment stays on one divider: one transaction per step
+    uint32_t worst = 0;
+    for (uint32_t f = 7074020UL; f < 7084000UL; f += 10) {
+        vfo.clearStats();
+        vfo.setFreq(0, f);
+        vfo.update(0);
+        CHECK(vfo.stats().transactions <= stepBudget.transactions);
+        if (vfo.stats().bytes > worst) worst = vfo.stats().bytes;
+    }
+    CHECK(worst <= sweepBytes);
+
+    vfo.setFreq(0, 7074000UL);
+    vfo.update(0);
+    static const uint32_t bands[] = {14074000UL, 3573000UL, 7074000UL, 28074000UL, 1840000UL};
+    for (uint8_t i = 0; i < sizeof(bands) / sizeof(bands[0]); i++) {
+        vfo.clearStats();
+        vfo.setFreq(0, bands[i]);
+        vfo.update(0);
+        checkBudget("band change", vfo.stats(), i ? anyBandBudget : bandBudget);
+    }
+    CHECK_EQ(vfo.getFreq(0), 1840000UL);
+
+    vfo.clearStats();
+    vfo.enable(1, true);
+    vfo.enable(1, false);
+    checkBudget("enable() on and off", vfo.stats(), (budget_t){2, 4, 0});
+    // Preset recall: PLLA, MS0/MS1, PHOFF and the reset; the first one also clears the CLK1
+    // inversion left by begin() (270°)
+    static const budget_t recallBudget = {4, 31, 1};
+    si_preset_t presets[2];
+    CHECK(!Si5351Bank::encode(presets[0], 25000000UL, 0, 7074000UL, PH180)); // Would need CLK1_CTL
+    CHECK(!Si5351Bank::encode(presets[0], 25000000UL, 0, 7074000UL, PH270));
+    CHECK(Si5351Bank::encode(presets[0], 25000000UL, 0, 7074000UL, PH090));
+    CHECK(Si5351Bank::encode(presets[1], 25000000UL, 0, 14074000UL, PH090));
+    Si5351Bank bank(vfo, presets, 2);
+    vfo.clearStats();
+    CHECK(vfo.reg(SI_CLK1_CTL) & SI_CLK_INV); // VFO0 still at 270° from begin()
+    CHECK(bank.recall(0));
+    CHECK(!(bus.regs[SI_CLK1_CTL] & SI_CLK_INV));
+    checkBudget("first recall()", vfo.stats(), (budget_t){5, 33, 1});
+    vfo.clearStats();
+    CHECK(bank.recall(1));
+    checkBudget("recall()", vfo.stats(), recallBudget);
+    CHECK_EQ(vfo.getFreq(0), 14074000UL);
+
+    // The DMA path only mirrors the frames (noteRegs()), and must count the same
+    vfo.clearStats();
+    const si_preset_t& e = presets[0];
+    for (uint8_t i = 0; i < e.words;) {
+        uint8_t reg = e.frame[i++] & 0xFF, buf[SI_BANK_WORDS], n = 0;
+        while (i < e.words) {
+            uint16_t w = e.frame[i++];
+            buf[n++] = w & 0xFF;
+            if (w & SI_BANK_STOP) break;
+        }
+        vfo.noteRegs(reg, buf, n);
+    }
+    checkBudget("DMA recall", vfo.stats(), recallBudget);
+    CHECK_EQ(vfo.stats().transactions, recallBudget.transactions);
+    CHECK_EQ(vfo.stats().resets, 1);
+    return checkResult("test_budget");
+}
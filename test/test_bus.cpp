@@ -0,0 +1,265 @@
+/*
+ * test_bus.cpp
+ *
+ * Bus failures: a write the bus does not complete must leave the register
+ * mirror as it was, be counted, make update() return false, and be sent again
+ * (with its PLL reset) by the next update(). Runs longer than the bus takes
+ * (maxWrite()) go out in several transactions, register maps included, and a
+ * map that does not load makes load() return false. A preset image with a
+ * register run outside the map is refused before anything is written, and
+ * restore() reports a failed write.
+ */
+
+#include "si5351.h"
+#include "check.h"
+#include "mock_bus.h"
+#include "si5351_map.h"
+#include "si5351_store.h"
+
+// Every register the driver has sent holds the same value on the chip
+static bool mirrorMatches(const Si5351& vfo, const MockBus& bus) {
+    for (uint8_t r = 1; r < SI_REG_COUNT; r++) {
+        if (r != SI_PLL_RESET && vfo.known(r) && vfo.reg(r) != bus.regs[r]) {
+            fprintf(stderr, "  register %u: mirror %02X, chip %02X\n", r, vfo.reg(r), bus.regs[r]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void testFailedUpdate() {
+    MockBus bus;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    CHECK(mirrorMatches(vfo, bus));
+
+    // A band change rewrites PLLA and both MultiSynths, then resets PLLA; the PLL write fails
+    vfo.clearStats();
+    CHECK(vfo.setFreq(0, 14200000UL));
+    bus.fail = 1;
+    CHECK(!vfo.update(0));
+    CHECK_EQ(vfo.stats().errors, 1);
+    CHECK_EQ(vfo.stats().resets, 0);
+    CHECK(mirrorMatches(vfo, bus)); // The MultiSynths arrived, the PLL did not
+    CHECK(!vfo.known(SI_SYNTH_PLLA + 3));
+
+    // The retry sends what did not arrive and the reset it still owes
+    CHECK(vfo.update(0));
+    CHECK_EQ(vfo.stats().resets, 1);
+    CHECK(mirrorMatches(vfo, bus));
+    CHECK_EQ(vfo.getFreq(0), 14200000UL);
+    uint32_t before = bus.writes;
+    CHECK(vfo.update(0)); // Nothing left to send
+    CHECK_EQ(bus.writes, before);
+}
+
+static void testFailedReset() {
+    MockBus bus;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    CHECK(vfo.setFreq(0, 3573000UL)); // New divider: needs a reset
+    bus.maxBytes = 2;                 // Only single-register writes go through: the reset, not the dividers
+    CHECK(!vfo.update(0));
+    CHECK(mirrorMatches(vfo, bus));
+    bus.maxBytes = 0;
+    vfo.clearStats();
+    CHECK(vfo.update(0));
+    CHECK_EQ(vfo.stats().resets, 1);
+    CHECK(mirrorMatches(vfo, bus));
+}
+
+static void testWriteRegs() {
+    MockBus bus;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    uint8_t oe = vfo.reg(SI_CLK_OE);
+    uint8_t off = 0xFF;
+    bus.fail = 1;
+    CHECK(!vfo.writeRegs(SI_CLK_OE, &off, 1));
+    CHECK_EQ(vfo.reg(SI_CLK_OE), oe);
+    CHECK(vfo.writeRegs(SI_CLK_OE, &off, 1));
+    CHECK_EQ(vfo.reg(SI_CLK_OE), 0xFF);
+    CHECK_EQ(bus.regs[SI_CLK_OE], 0xFF);
+
+    // Runs past the register map never reach the bus or the mirror
+    uint8_t run[80] = {};
+    uint32_t before = bus.writes + bus.rejected;
+    CHECK(!vfo.writeRegs(180, run, 10));
+    CHECK(!vfo.writeRegs(SI_REG_COUNT - 1, run, 2));
+    CHECK(!vfo.writeRegs(0, run, 0));
+    CHECK_EQ(bus.writes + bus.rejected, before);
+    CHECK(vfo.writeRegs(SI_REG_COUNT - 1, run, 1));
+}
+
+// A PIO-like bus refuses writes over 64 bytes; a long run must arrive in pieces that fit
+static void testLongRun() {
+    MockBus bus;
+    bus.limit = bus.maxBytes = 64;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    uint8_t data[92 - 15 + 1];
+    for (uint8_t i = 0; i < sizeof(data); i++) data[i] = 0x40 + i;
+    vfo.clearStats();
+    CHECK(vfo.writeRegs(15, data, sizeof(data))); // 79 bytes with the register address
+    CHECK_EQ(bus.rejected, 0);
+    CHECK(bus.longest <= 64);
+    CHECK_EQ(vfo.stats().transactions, 2);
+    CHECK_EQ(vfo.stats().bytes, sizeof(data) + 2);
+    CHECK_BYTES(&bus.regs[15], data, sizeof(data));
+    CHECK(mirrorMatches(vfo, bus));
+
+    // The staged path too: a narrow bus still gets every register of begin() and a band change
+    MockBus narrow;
+    narrow.limit = narrow.maxBytes = 4;
+    Si5351 vfo2;
+    vfo2.setBus(&narrow);
+    vfo2.begin();
+    CHECK(vfo2.setFreq(0, 14200000UL));
+    CHECK(vfo2.update(0));
+    CHECK_EQ(narrow.rejected, 0);
+    CHECK(mirrorMatches(vfo2, narrow));
+    CHECK(vfo2.known(SI_SYNTH_PLLA + 7));
+}
+
+// A ClockBuilder map with runs over the PIO limit loads in pieces; a failure is reported
+static void testLoad() {
+    Si5351Map map;
+    for (uint8_t r = 15; r <= 92; r++) map.set(r, r);
+    for (uint8_t r = 149; r <= 170; r++) map.set(r, 0);
+    map.set(SI_CLK_OE, 0xFA);
+
+    MockBus bus;
+    bus.limit = bus.maxBytes = 64;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    vfo.clearStats();
+    CHECK(map.load(vfo));
+    CHECK_EQ(bus.rejected, 0);
+    CHECK_EQ(vfo.stats().resets, 1);
+    CHECK(mirrorMatches(vfo, bus));
+    CHECK_EQ(bus.regs[SI_CLK_OE], 0xFA);
+    bool all = true;
+    for (uint8_t r = 15; r <= 92; r++) all &= bus.regs[r] == r;
+    CHECK(all);
+
+    // The outputs go off, then the registers fail: no reset, outputs stay off, a second load finishes
+    for (uint8_t r = 15; r <= 92; r++) map.set(r, r + 1);
+    bus.maxBytes = 2;
+    vfo.clearStats();
+    CHECK(!map.load(vfo));
+    CHECK_EQ(vfo.stats().resets, 0);
+    CHECK_EQ(bus.regs[SI_CLK_OE], 0xFF);
+    CHECK(mirrorMatches(vfo, bus));
+    bus.maxBytes = 64;
+    CHECK(map.load(vfo));
+    CHECK_EQ(bus.regs[SI_CLK_OE], 0xFA);
+    CHECK_EQ(bus.regs[92], 93);
+    CHECK(mirrorMatches(vfo, bus));
+
+    // Not even the outputs-off write goes through: the outputs are left as they were
+    bus.fail = 1;
+    CHECK(!map.load(vfo));
+    CHECK_EQ(vfo.reg(SI_CLK_OE), 0xFA);
+    CHECK(mirrorMatches(vfo, bus));
+
+    // The chip already holds the map: outputs off, the reset and outputs on
+    vfo.clearStats();
+    CHECK(map.load(vfo));
+    CHECK_EQ(vfo.stats().transactions, 3);
+}
+
+static void testRestore() {
+    uint8_t img[400];
+    uint8_t regs[SI_REG_COUNT] = {};
+
+    // The writer refuses runs past the register map
+    Si5351StoreWriter w(img, sizeof(img));
+    CHECK(w.addXtal(25000000UL));
+    CHECK(!w.addRegs(180, regs, 10));
+    CHECK_EQ(w.finish(), 0);
+
+    // A hand-made image with a 300-byte run: valid CRC, but nothing may reach the chip
+    uint16_t len = 3 + 1 + 300;
+    memset(img, 0, sizeof(img));
+    img[0] = SI_STORE_MAGIC0;
+    img[1] = SI_STORE_MAGIC1;
+    img[2] = SI_STORE_VERSION;
+    img[4] = len & 0xFF;
+    img[5] = len >> 8;
+    img[6] = 1;
+    img[10] = SI_REC_REGS;
+    img[11] = (len - 3) & 0xFF;
+    img[12] = (len - 3) >> 8;
+    img[13] = 16;
+    uint16_t crc = si5351Crc16(0xFFFF, &img[SI_STORE_HEADER], len);
+    img[8] = crc & 0xFF;
+    img[9] = crc >> 8;
+    MockBus bus;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    Si5351StoreReader bad(img, sizeof(img));
+    CHECK(bad.valid());
+    CHECK(!bad.restore(vfo));
+    CHECK_EQ(bus.writes + bus.rejected, 0);
+
+    // A good image restores; the same image on a failing bus reports it
+    Si5351StoreWriter good(img, sizeof(img));
+    for (uint8_t i = 0; i < 8; i++) regs[i] = 0x10 + i;
+    CHECK(good.addXtal(25000000UL));
+    CHECK(good.addRegs(SI_SYNTH_MS2, regs, 8));
+    CHECK(good.finish() > 0);
+    Si5351StoreReader r(img, sizeof(img));
+    CHECK(r.restore(vfo));
+    CHECK_BYTES(&bus.regs[SI_SYNTH_MS2], regs, 8);
+    MockBus dead;
+    dead.fail = 0xFFFF;
+    Si5351 vfo2;
+    vfo2.setBus(&dead);
+    CHECK(!r.restore(vfo2));
+    dead.fail = 0;
+    CHECK(vfo2.begin()); // Retried from scratch
+    CHECK(mirrorMatches(vfo2, dead));
+
+    // begin() goes through, the register run is too long for the bus
+    Si5351StoreWriter runs(img, sizeof(img));
+    CHECK(runs.addRegs(150, regs, 30));
+    CHECK(runs.finish() > 0);
+    MockBus shortBus;
+    shortBus.maxBytes = 24; // Not reported by maxWrite(): the 31-byte write is refused
+    Si5351 vfo3;
+    vfo3.setBus(&shortBus);
+    Si5351StoreReader rr(img, sizeof(img));
+    CHECK(!rr.restore(vfo3));
+    CHECK_EQ(shortBus.rejected, 1);
+}
+
+// A transfer behind the driver's back that may have landed partly (aborted DMA recall): once
+// forgotten, the registers are rewritten by the next update()
+static void testForget() {
+    MockBus bus;
+    Si5351 vfo;
+    vfo.setBus(&bus);
+    vfo.begin();
+    for (uint8_t i = 0; i < 8; i++) bus.regs[SI_SYNTH_PLLA + i] ^= 0x5A; // Half a recall got through
+    vfo.forgetRegs(SI_SYNTH_PLLA, 8);
+    CHECK(!vfo.known(SI_SYNTH_PLLA));
+    CHECK(vfo.update(0));
+    CHECK(vfo.known(SI_SYNTH_PLLA + 7));
+    CHECK(mirrorMatches(vfo, bus));
+}
+
+int main() {
+    testFailedUpdate();
+    testFailedReset();
+    testWriteRegs();
+    testLongRun();
+    testLoad();
+    testRestore();
+    testForget();
+    return checkResult("test_bus");
+}
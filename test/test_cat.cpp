@@ -0,0 +1,82 @@
+/*
+ * test_cat.cpp
+ *
+ * Kenwood CAT parser on a mock port: command framing (';', line ends, lower
+ * case), frequency sets coalesced into one bus update per poll(), the FA/IF
+ * reply layouts, errors answered "?;", and an overlong command dropped up to
+ * its ';' without its tail running as a command of its own.
+ */
+
+#include <string.h>
+#include "si5351_cat.h"
+#include "check.h"
+#include "mock_bus.h"
+#include "mock_stream.h"
+
+#define CHECK_STR(got, want) CHECK(strcmp((got), (want)) == 0 || (fprintf(stderr, "  got \"%s\"\n", (got)), 0))
+
+int main() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    MockStream port;
+    Si5351Cat cat(vfo, port);
+
+    // Set and query, line ends and lower case accepted; a set has no answer
+    port.feed("FA00007074000;\r\nfa;");
+    cat.poll();
+    CHECK_STR(port.take(), "FA00007074000;");
+    CHECK_EQ(vfo.getTarget(0), 7074000UL);
+
+    // Several sets in one poll(): the last one wins, written in one update
+    vfo.clearStats();
+    port.feed("FA00007074010;FA00007074020;FA00007074030;");
+    cat.poll();
+    CHECK_STR(port.take(), "");
+    CHECK_EQ(vfo.getTarget(0), 7074030UL);
+    CHECK_EQ(vfo.stats().transactions, 1);
+
+    // A command split across polls is completed by the next one
+    port.feed("FA0000707");
+    cat.poll();
+    CHECK_EQ(vfo.getTarget(0), 7074030UL);
+    port.feed("4000;");
+    cat.poll();
+    CHECK_EQ(vfo.getTarget(0), 7074000UL);
+
+    // IF: 38 characters; frequency, step, RIT/XIT, memory, then TX flag and mode at 28 and 29
+    port.feed("MD3;TX;IF;");
+    cat.poll();
+    const char* r = port.take();
+    CHECK_EQ(strlen(r), 38);
+    CHECK_STR(r, "IF00007074000     +000000000130000000;");
+    CHECK(cat.transmitting());
+    port.feed("RX;IF;");
+    cat.poll();
+    r = port.take();
+    CHECK_EQ(r[28], '0');
+    CHECK_EQ(r[29], '3');
+
+    // Errors: unknown command, bad digits, out of range, too short
+    port.feed("ZZ;FAabc;FA00000001000;X;");
+    cat.poll();
+    CHECK_STR(port.take(), "?;?;?;?;");
+    CHECK_EQ(vfo.getTarget(0), 7074000UL);
+
+    // Overlong command: one "?;", its tail (a valid FA set here) is not run, the next command is
+    char longCmd[SI_CAT_MAX + 32];
+    memset(longCmd, 'X', SI_CAT_MAX);
+    strcpy(longCmd + SI_CAT_MAX, "FA00014074000;ID;");
+    port.feed(longCmd);
+    cat.poll();
+    CHECK_STR(port.take(), "?;ID019;");
+    CHECK_EQ(vfo.getTarget(0), 7074000UL);
+
+    // Fixed answers for hamlib
+    port.feed("ID;AI;PS;FR;FT;AI0;MD;");
+    cat.poll();
+    CHECK_STR(port.take(), "ID019;AI0;PS1;FR0;FT0;MD3;");
+
+    return checkResult("test_cat");
+}
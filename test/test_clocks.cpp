@@ -0,0 +1,112 @@
+/*
+ * test_clocks.cpp
+ *
+ * PLL allocation planner against a mock bus: a lone CLK2 change leaves PLLA
+ * and the CLK0/CLK1 dividers alone, a quadrature pair always gets the same
+ * even integer divider on one PLL, and every output of a returned plan is
+ * within 1 Hz of its target (freqOf()). Random target sets are chained through
+ * set(), so plans are made against a current plan as in use.
+ */
+
+#include <stdlib.h>
+#include "si5351_clocks.h"
+#include "check.h"
+#include "mock_bus.h"
+
+static uint32_t rng = 12345;
+
+static uint32_t nextRandom() {
+    rng = rng * 1103515245UL + 12345UL;
+    return rng >> 8;
+}
+
+// 10 kHz .. 100 MHz, log-spread so the low bands (R dividers) get their share
+static uint32_t randomFreq() {
+    static const uint32_t decade[] = {10000UL, 100000UL, 1000000UL, 10000000UL};
+    uint32_t base = decade[nextRandom() % 4];
+    return base + nextRandom() % (base * 9);
+}
+
+static bool withinHz(const si_clock_plan_t& p, uint32_t xtal) {
+    for (uint8_t k = 0; k < 3; k++) {
+        if (!p.freq[k]) continue;
+        uint32_t f = Si5351Clocks::freqOf(xtal, p, k);
+        if ((f > p.freq[k] ? f - p.freq[k] : p.freq[k] - f) > 1) {
+            fprintf(stderr, "  CLK%u: target %lu, plan gives %lu\n", k, (unsigned long)p.freq[k], (unsigned long)f);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool quadIntegral(const si_clock_plan_t& p) {
+    return p.pll[0] == p.pll[1] && p.msb[0] == 0 && p.msb[1] == 0 && !(p.msa[0] & 1) &&
+           p.msa[0] == p.msa[1] && p.ri[0] == p.ri[1];
+}
+
+// CLK2 alone moves: PLLA and both MultiSynths of the quadrature pair stay as they are
+static void testLoneClk2() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    Si5351Clocks clocks(vfo);
+    uint32_t f[3] = {7074000UL, 7074000UL, 48000000UL};
+    CHECK(clocks.set(f, PH090));
+    si_clock_plan_t before = clocks.current();
+    CHECK(quadIntegral(before));
+
+    static const uint32_t clk2[] = {10000000UL, 10000001UL, 27000000UL, 100000UL, 48000000UL, 3579545UL};
+    for (uint8_t i = 0; i < sizeof(clk2) / sizeof(clk2[0]); i++) {
+        f[2] = clk2[i];
+        si_clock_plan_t p;
+        CHECK(clocks.plan(f, PH090, p));
+        uint8_t a = before.pll[0];
+        CHECK_EQ(p.msna[a], before.msna[a]);
+        CHECK_EQ(p.msnb[a], before.msnb[a]);
+        for (uint8_t k = 0; k < 2; k++) {
+            CHECK_EQ(p.pll[k], before.pll[k]);
+            CHECK_EQ(p.msa[k], before.msa[k]);
+            CHECK_EQ(p.msb[k], before.msb[k]);
+            CHECK_EQ(p.ri[k], before.ri[k]);
+        }
+        CHECK_EQ(clocks.resets(), 0);
+        CHECK(withinHz(p, vfo.getXtal()));
+        CHECK(clocks.set(f, PH090));
+        before = clocks.current();
+    }
+}
+
+// Random target sets, chained: plans are exact to 1 Hz and quadrature pairs stay integral
+static void testRandom(uint32_t cases) {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    Si5351Clocks clocks(vfo);
+    uint32_t planned = 0, offTarget = 0, fractionalPair = 0;
+    for (uint32_t i = 0; i < cases; i++) {
+        uint32_t f[3];
+        for (uint8_t k = 0; k < 3; k++) f[k] = nextRandom() % 8 ? randomFreq() : 0;
+        uint8_t phase = nextRandom() % 2 ? (uint8_t)(nextRandom() % 4) : SI_PLAN_FREE;
+        if (phase != SI_PLAN_FREE && !f[0]) f[0] = randomFreq();
+        si_clock_plan_t p;
+        if (!clocks.plan(f, phase, p)) continue;
+        planned++;
+        if (!withinHz(p, vfo.getXtal())) offTarget++;
+        if (phase != SI_PLAN_FREE && !quadIntegral(p)) fractionalPair++;
+        if (nextRandom() % 4 == 0) clocks.reset();
+        else clocks.set(f, phase);
+    }
+    CHECK(planned > cases / 2);
+    CHECK_EQ(offTarget, 0);
+    CHECK_EQ(fractionalPair, 0);
+}
+
+int main(int argc, char** argv) {
+    uint32_t cases = argc > 1 ? strtoul(argv[1], nullptr, 0) : 20000;
+    if (argc > 2) rng = strtoul(argv[2], nullptr, 0);
+    testLoneClk2();
+    testRandom(cases);
+    return checkResult("test_clocks");
+}
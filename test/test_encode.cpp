@@ -0,0 +1,115 @@
+/*
+ * test_encode.cpp
+ *
+ * Golden register images: the PLL and MultiSynth encoders against byte images
+ * worked out from the AN619 formulas (section 3.2 and 4.1.2), and the driver's
+ * R divider codes as they reach the chip.
+ */
+
+#include "si5351.h"
+#include "check.h"
+#include "mock_bus.h"
+
+static void testMultiSynthInteger() {
+    uint8_t buf[8];
+
+    // Divide by 4: P1 = 0, MSx_DIVBY4 = 11
+    static const uint8_t div4[8] = {0x00, 0x01, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00};
+    Si5351::encodeMSI(buf, 4, 0);
+    CHECK_BYTES(buf, div4, 8);
+
+    // Divide by 6: P1 = 256, no DIVBY4
+    static const uint8_t div6[8] = {0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00};
+    Si5351::encodeMSI(buf, 6, 0);
+    CHECK_BYTES(buf, div6, 8);
+
+    // Divide by 126: P1 = 15616, every R code in bits 6:4 of the third byte
+    for (uint8_t r = 0; r < 8; r++) {
+        const uint8_t div126[8] = {0x00, 0x01, (uint8_t)(r << 4), 0x3D, 0x00, 0x00, 0x00, 0x00};
+        Si5351::encodeMSI(buf, 126, r);
+        CHECK_BYTES(buf, div126, 8);
+    }
+}
+
+static void testMultiSynthFractional() {
+    uint8_t buf[8];
+
+    // 12 + 1/3, R = 4: P1 = 1066, P2 = 2, P3 = 3
+    static const uint8_t frac[8] = {0x00, 0x03, 0x20, 0x04, 0x2A, 0x00, 0x00, 0x02};
+    Si5351::encodeMS(buf, 12, 1, 3, 2);
+    CHECK_BYTES(buf, frac, 8);
+
+    // Largest fields: 2047 + 1048574/1048575, R = 128; P1 and P3 use their top bits
+    static const uint8_t top[8] = {0xFF, 0xFF, 0x73, 0xFD, 0xFF, 0xFF, 0xFF, 0x7F};
+    Si5351::encodeMS(buf, 2047, 1048574, 1048575, 7);
+    CHECK_BYTES(buf, top, 8);
+
+    // 4 with a fraction is not divide-by-4 mode
+    Si5351::encodeMS(buf, 4, 1, 2, 0);
+    CHECK_EQ(buf[2] & SI_MS_DIVBY4, 0);
+}
+
+static void testPll() {
+    uint8_t buf[8];
+
+    // b/c = 999999/1000000: floor(128b/c) = 127 and P2 takes the rest (999872)
+    static const uint8_t nearOne[8] = {0x42, 0x40, 0x00, 0x10, 0x7F, 0xFF, 0x41, 0xC0};
+    Si5351::encodeMSN(buf, 36, 999999, 1000000);
+    CHECK_BYTES(buf, nearOne, 8);
+
+    static const uint8_t smallest[8] = {0x42, 0x40, 0x00, 0x05, 0x80, 0xF0, 0x00, 0x80}; // 15 + 1/10^6
+    Si5351::encodeMSN(buf, 15, 1, 1000000);
+    CHECK_BYTES(buf, smallest, 8);
+
+    static const uint8_t largest[8] = {0x42, 0x40, 0x00, 0x2B, 0x00, 0xF0, 0x00, 0x00}; // 90
+    Si5351::encodeMSN(buf, 90, 0, 1000000);
+    CHECK_BYTES(buf, largest, 8);
+
+    // A numerator that rounds up to c carries into the integer part: 699999996 Hz VCO is 28 + 0
+    vfo_t v;
+    CHECK(Si5351::planDivider(25000000UL, 174999999UL, 1, 4, v));
+    CHECK_EQ(v.msna, 28);
+    CHECK_EQ(v.msnb, 0);
+}
+
+// begin() with the default 7.074 MHz on VFO0: PLLA 27 + 730080/10^6 (693.252 MHz), MS0 = MS1 = 98
+static void testBeginImage() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    vfo.begin();
+    static const uint8_t plla[8] = {0x42, 0x40, 0x00, 0x0B, 0xDD, 0xF6, 0xDE, 0xC0};
+    static const uint8_t ms98[8] = {0x00, 0x01, 0x00, 0x2F, 0x00, 0x00, 0x00, 0x00};
+    CHECK_BYTES(&bus.regs[SI_SYNTH_PLLA], plla, 8);
+    CHECK_BYTES(&bus.regs[SI_SYNTH_MS0], ms98, 8);
+    CHECK_BYTES(&bus.regs[SI_SYNTH_MS1], ms98, 8);
+    CHECK_EQ(bus.regs[SI_CLK1_PHOFF], 98); // PH270: 90° offset plus inversion
+}
+
+// Every R divider the driver accepts reaches the chip as its code, on both quadrature outputs
+static void testRCodes() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    vfo.begin();
+    for (uint8_t code = 0; code < 8; code++) {
+        uint8_t r = 1 << code;
+        vfo_t v;
+        CHECK(Si5351::planDivider(25000000UL, 700000000UL / (50UL * r), r, 50, v)); // 700 MHz VCO
+        v.phase = PH000;
+        CHECK(vfo.setVfo(0, v));
+        vfo.update(0);
+        CHECK_EQ((bus.regs[SI_SYNTH_MS0 + 2] >> 4) & 0x07, code);
+        CHECK_EQ((bus.regs[SI_SYNTH_MS1 + 2] >> 4) & 0x07, code);
+        CHECK_EQ(bus.regs[SI_SYNTH_MS0 + 3], 0x17); // P1 = 128 * 50 - 512 = 5888
+    }
+}
+
+int main() {
+    testMultiSynthInteger();
+    testMultiSynthFractional();
+    testPll();
+    testBeginImage();
+    testRCodes();
+    return checkResult("test_encode");
+}
@@ -0,0 +1,41 @@
+/*
+ * test_glide.cpp
+ *
+ * Glide stepping against a mock bus: steps and divider changes are counted
+ * only when they reach the chip, and a step that does not ends the glide.
+ */
+
+#include "si5351_glide.h"
+#include "check.h"
+#include "mock_bus.h"
+
+int main() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    CHECK(vfo.setFreq(0, 7000000UL));
+
+    // 7 -> 7.1 MHz in 10 ms: numerator-only steps, the target lands on the last one
+    Si5351Glide glide(vfo, 0);
+    CHECK(glide.start(7100000UL, 10000, 0));
+    for (uint32_t t = 0; glide.active() && t <= 20000; t += 1000) glide.poll(t);
+    CHECK(!glide.active());
+    CHECK_EQ(glide.steps(), 11);
+    CHECK_EQ(glide.changes(), 0);
+    CHECK_EQ(vfo.getTarget(0), 7100000UL);
+
+    // A bus failure mid-glide stops it without counting the lost step
+    CHECK(glide.start(7000000UL, 10000, 100000));
+    glide.poll(100000);
+    glide.poll(101000);
+    CHECK_EQ(glide.steps(), 2);
+    bus.fail = 1;
+    glide.poll(102000);
+    CHECK(!glide.active());
+    CHECK_EQ(glide.steps(), 2);
+    glide.poll(103000);
+    CHECK_EQ(glide.steps(), 2);
+
+    return checkResult("test_glide");
+}
@@ -0,0 +1,156 @@
+/*
+ * test_link.cpp
+ *
+ * Binary control link on a mock port: frames split across polls, garbage and
+ * corrupted frames skipped (and counted) without losing the frame behind
+ * them, frequency frames coalesced into one bus update per VFO, replies
+ * encoded as frames, and NAKs for a missing VFO, a 0 Hz target and an
+ * unknown command.
+ */
+
+#include "si5351_link.h"
+#include "check.h"
+#include "mock_bus.h"
+#include "mock_stream.h"
+
+static uint8_t buf[SI_FRAME_MAX + SI_FRAME_OVERHEAD];
+
+static void sendFreq(MockStream& port, uint8_t vfoIdx, uint32_t hz) {
+    uint8_t d[5] = {vfoIdx};
+    siPut32(&d[1], hz);
+    port.feed(buf, Si5351FrameParser::encode(buf, SI_CMD_FREQ, d, sizeof(d)));
+}
+
+// Decode the port output as one frame
+static bool reply(MockStream& port, si_frame_t& f) {
+    Si5351FrameParser p;
+    for (uint16_t i = 0; i < port.outLen; i++) p.push(port.out[i]);
+    port.outLen = 0;
+    return p.next(f);
+}
+
+static void testFraming() {
+    // Encode layout and CRC-8 (0x07) check value
+    uint8_t crc = 0;
+    for (const char* s = "123456789"; *s; s++) crc = Si5351FrameParser::crc8(crc, (uint8_t)*s);
+    CHECK_EQ(crc, 0xF4);
+    static const uint8_t d[2] = {0x12, 0x34};
+    CHECK_EQ(Si5351FrameParser::encode(buf, 0x03, d, 2), 6);
+    CHECK_EQ(buf[0], SI_FRAME_SYNC);
+    CHECK_EQ(buf[1], 2);
+    CHECK_EQ(buf[2], 0x03);
+    CHECK_EQ(buf[5], Si5351FrameParser::crc8(Si5351FrameParser::crc8(Si5351FrameParser::crc8(
+                         Si5351FrameParser::crc8(0, 2), 0x03), 0x12), 0x34));
+
+    // Garbage, a false SYNC, a bad CRC and an impossible length, then a good frame byte by byte
+    Si5351FrameParser p;
+    si_frame_t f;
+    static const uint8_t junk[] = {0x00, 0x55, SI_FRAME_SYNC, SI_FRAME_MAX + 1};
+    for (uint8_t b : junk) p.push(b);
+    uint8_t n = Si5351FrameParser::encode(buf, 0x03, d, 2);
+    buf[n - 1] ^= 1;
+    for (uint8_t i = 0; i < n; i++) p.push(buf[i]);
+    CHECK(!p.next(f));
+    CHECK_EQ(p.errors(), 2);
+    n = Si5351FrameParser::encode(buf, 0x03, d, 2);
+    for (uint8_t i = 0; i < n; i++) {
+        CHECK(!p.next(f)); // Incomplete until the CRC arrives
+        p.push(buf[i]);
+    }
+    CHECK(p.next(f));
+    CHECK_EQ(f.cmd, 0x03);
+    CHECK_EQ(f.len, 2);
+    CHECK_EQ(f.data[1], 0x34);
+    CHECK(!p.next(f));
+}
+
+static void testLink() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    MockStream port;
+    Si5351Link link(vfo, port);
+    si_frame_t f;
+
+    // Three targets for VFO0 in one poll: one update, two coalesced, no reply
+    vfo.clearStats();
+    sendFreq(port, 0, 7074000UL);
+    sendFreq(port, 0, 7074100UL);
+    sendFreq(port, 0, 7074200UL);
+    link.poll();
+    CHECK_EQ(port.outLen, 0);
+    CHECK_EQ(link.frames(), 3);
+    CHECK_EQ(link.coalesced(), 2);
+    CHECK_EQ(vfo.getTarget(0), 7074200UL);
+    CHECK_EQ(vfo.stats().transactions, 1);
+
+    // A frame split across polls, behind a corrupted one
+    sendFreq(port, 0, 14074000UL);
+    port.in[port.inLen - 1] ^= 0xFF;
+    uint8_t d[5] = {0};
+    siPut32(&d[1], 10000000UL);
+    uint8_t n = Si5351FrameParser::encode(buf, SI_CMD_FREQ, d, sizeof(d));
+    port.feed(buf, 3);
+    link.poll();
+    CHECK_EQ(vfo.getTarget(0), 7074200UL);
+    port.feed(buf + 3, n - 3);
+    link.poll();
+    CHECK_EQ(vfo.getTarget(0), 10000000UL);
+    CHECK_EQ(link.parser().errors(), 1);
+
+    // GET_FREQ answers with a reply frame: vfo, target, actual
+    uint8_t q = 0;
+    port.feed(buf, Si5351FrameParser::encode(buf, SI_CMD_GET_FREQ, &q, 1));
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.cmd, SI_CMD_GET_FREQ | SI_CMD_REPLY);
+    CHECK_EQ(f.len, 9);
+    CHECK_EQ(f.data[0], 0);
+    CHECK_EQ(siGet32(&f.data[1]), 10000000UL);
+    CHECK_EQ(siGet32(&f.data[5]), vfo.getFreq(0));
+
+    // 0 Hz: NAK, the frequency stays and nothing is written
+    vfo.clearStats();
+    sendFreq(port, 0, 0);
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.cmd, SI_CMD_NAK | SI_CMD_REPLY);
+    CHECK_EQ(f.len, 2);
+    CHECK_EQ(f.data[0], SI_CMD_FREQ);
+    CHECK_EQ(f.data[1], 0);
+    CHECK_EQ(vfo.getTarget(0), 10000000UL);
+    CHECK_EQ(vfo.stats().transactions, 0);
+
+    // No such VFO, an out-of-range target, an unknown command
+    sendFreq(port, SI5351_VFO_COUNT, 7000000UL);
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.cmd, SI_CMD_NAK | SI_CMD_REPLY);
+    CHECK_EQ(f.data[1], SI5351_VFO_COUNT);
+    sendFreq(port, 0, 1000UL);
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.cmd, SI_CMD_NAK | SI_CMD_REPLY);
+    CHECK_EQ(vfo.getTarget(0), 10000000UL);
+    port.feed(buf, Si5351FrameParser::encode(buf, 0x42, nullptr, 0));
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.data[0], 0x42);
+    CHECK_EQ(f.data[1], 0xFF);
+
+    // Stats reply carries the link counters
+    port.feed(buf, Si5351FrameParser::encode(buf, SI_CMD_GET_STATS, nullptr, 0));
+    link.poll();
+    CHECK(reply(port, f));
+    CHECK_EQ(f.len, 28);
+    CHECK_EQ(siGet32(&f.data[16]), link.frames());
+    CHECK_EQ(siGet32(&f.data[20]), 1);
+    CHECK_EQ(siGet32(&f.data[24]), 2);
+}
+
+int main() {
+    testFraming();
+    testLink();
+    return checkResult("test_link");
+}
@@ -0,0 +1,120 @@
+/*
+ * test_lock.cpp
+ *
+ * Lock confirmation without blocking: an update() that resets the PLL or
+ * changes band returns at once, without reading the status register, and the
+ * first pollLock() that reads lock calls the band hook with SI_BAND_LOCKED and
+ * pushes the LO event. A PLL that does not lock is reported after
+ * SI_LOCK_TIMEOUT_US, a numerator step publishes its event from update().
+ */
+
+#include "si5351.h"
+#include "check.h"
+#include "mock_bus.h"
+
+struct Hook {
+    uint8_t n = 0;
+    uint8_t point[16];
+    uint8_t to[16];
+};
+
+static void onBand(void* ctx, uint8_t vfoIdx, uint8_t from, uint8_t to, uint8_t point) {
+    (void)vfoIdx;
+    (void)from;
+    Hook* h = (Hook*)ctx;
+    if (h->n < 16) {
+        h->point[h->n] = point;
+        h->to[h->n] = to;
+    }
+    h->n++;
+}
+
+int main() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    CHECK(vfo.begin());
+    Si5351LoQueue q;
+    si_lo_event_t e;
+    Hook hook;
+    static const uint32_t edges[] = {5000000UL, 10000000UL};
+    vfo.setEventQueue(&q);
+    vfo.setBands(edges, 2);
+    vfo.onBandChange(onBand, &hook);
+
+    // Band change with the PLL not locked yet: update() returns before lock, no status read
+    bus.status = SI_STATUS_LOL_A;
+    CHECK(vfo.setFreq(0, 7000000UL));
+    vfo.clearStats();
+    unsigned long t0 = micros();
+    CHECK(vfo.update(0));
+    CHECK(micros() - t0 < 100);
+    CHECK_EQ(vfo.stats().reads, 0);
+    CHECK_EQ(hook.n, 2);
+    CHECK_EQ(hook.point[0], SI_BAND_BEFORE);
+    CHECK_EQ(hook.point[1], SI_BAND_RELOCK);
+    CHECK(!q.pop(e));
+
+    // Still unlocked: pending; then the poll that sees lock publishes both
+    hostAdvance(500);
+    CHECK(vfo.pollLock());
+    CHECK_EQ(hook.n, 2);
+    CHECK(!q.pop(e));
+    bus.status = 0;
+    hostAdvance(500);
+    unsigned long seen = micros();
+    CHECK(!vfo.pollLock());
+    CHECK_EQ(hook.n, 3);
+    CHECK_EQ(hook.point[2], SI_BAND_LOCKED);
+    CHECK_EQ(hook.to[2], 1);
+    CHECK(q.pop(e));
+    CHECK_EQ(e.flags, SI_LO_RESET);
+    CHECK_EQ(e.freq, 7000000UL);
+    CHECK(e.reset >= e.written && e.locked > e.reset + 1000 && e.locked - seen < 100);
+    CHECK(!q.pop(e));
+    CHECK(!vfo.pollLock());
+    CHECK_EQ(hook.n, 3);
+
+    // Numerator step: published by update() itself, locked == written
+    CHECK(vfo.setFreq(0, 7001000UL));
+    CHECK(vfo.update(0));
+    CHECK(q.pop(e));
+    CHECK_EQ(e.flags, 0);
+    CHECK_EQ(e.locked, e.written);
+    CHECK_EQ(hook.n, 3);
+
+    // No lock at all: SI_BAND_NOLOCK and SI_LO_NOLOCK after the timeout
+    bus.status = SI_STATUS_LOL_A;
+    CHECK(vfo.setFreq(0, 14000000UL));
+    CHECK(vfo.update(0));
+    hostAdvance(SI_LOCK_TIMEOUT_US / 2);
+    CHECK(vfo.pollLock());
+    hostAdvance(SI_LOCK_TIMEOUT_US);
+    CHECK(!vfo.pollLock());
+    CHECK_EQ(hook.n, 6);
+    CHECK_EQ(hook.point[5], SI_BAND_NOLOCK);
+    CHECK(q.pop(e));
+    CHECK_EQ(e.flags, SI_LO_RESET | SI_LO_NOLOCK);
+
+    // A newer update() settles the owed one first, so events stay in order
+    CHECK(vfo.setFreq(0, 7000000UL));
+    CHECK(vfo.update(0));
+    CHECK(vfo.setFreq(0, 3000000UL));
+    CHECK(vfo.update(0));
+    CHECK_EQ(hook.n, 11);
+    CHECK_EQ(hook.point[8], SI_BAND_NOLOCK);
+    bus.status = 0;
+    CHECK(!vfo.pollLock());
+    CHECK_EQ(hook.n, 12);
+    CHECK_EQ(hook.point[11], SI_BAND_LOCKED);
+    si_lo_event_t first, second;
+    CHECK(q.pop(first));
+    CHECK(q.pop(second));
+    CHECK_EQ(second.seq, first.seq + 1);
+    CHECK_EQ(first.freq, 7000000UL);
+    CHECK_EQ(first.flags & SI_LO_NOLOCK, SI_LO_NOLOCK);
+    CHECK_EQ(second.freq, 3000000UL);
+    CHECK_EQ(second.flags, SI_LO_RESET);
+
+    return checkResult("test_lock");
+}
@@ -0,0 +1,235 @@
+/*
+ * test_pio.cpp
+ *
+ * PIO I2C frames on the host: the frames of buildWrite()/buildRead() are played
+ * against a bus model with a Si5351-like slave (open-drain SDA, START and STOP
+ * detection, bits taken on the SCL rising edge). Checks the bytes the slave
+ * sees, START/STOP placement, that the ACK and data sample slots fall in an
+ * SCL high phase and read what the slave drove, and the frame length limits.
+ */
+
+#include "si5351_pio.h"
+#include "check.h"
+
+// Slave at 0x60 with a register pointer: ACKs its address and every written byte,
+// drives register data on reads
+struct Slave {
+    uint8_t addr = 0x60;
+    uint8_t regs[256] = {};
+    uint8_t got[SI_PIO_MAX_BYTES + 2]; // Bytes of the last write, address byte included
+    uint8_t gotLen = 0;
+    uint8_t ptr = 0;
+    uint8_t starts = 0, stops = 0, nacked = 0; // nacked: reads the master ended with a NACK
+    uint8_t masterAcks = 0;
+
+    bool drive = false; // Pulling SDA low
+    bool active = false, reading = false, ackSlot = false, ours = false, first = true;
+    uint8_t bit = 0, shift = 0, out = 0;
+
+    void start() {
+        starts++;
+        active = true;
+        reading = false;
+        ackSlot = false;
+        first = true;
+        bit = 0;
+        drive = false;
+        gotLen = 0;
+    }
+    void stop() {
+        stops++;
+        active = false;
+        drive = false;
+    }
+    void rise(bool sda) {
+        if (!active) return;
+        if (ackSlot) {
+            if (reading && !ours) {
+                if (sda) nacked++;
+                else masterAcks++;
+                active = !sda; // After a NACK the slave waits for STOP
+            }
+            return;
+        }
+        shift = shift << 1 | sda;
+        bit++;
+    }
+    void fall() {
+        if (!active) return;
+        if (ackSlot) { // End of the ACK clock
+            ackSlot = false;
+            drive = false;
+            if (reading) {
+                out = regs[ptr++];
+                drive = !(out & 0x80);
+            }
+            return;
+        }
+        if (reading) {
+            if (bit == 8) { // Byte out, release SDA for the master's ACK
+                bit = 0;
+                drive = false;
+                ackSlot = true;
+                ours = false;
+            } else {
+                drive = !((out << bit) & 0x80);
+            }
+            return;
+        }
+        if (bit < 8) return;
+        bit = 0;
+        if (first) {
+            first = false;
+            if ((shift >> 1) != addr) { // Not ours: no ACK, ignore the rest
+                active = false;
+                return;
+            }
+            reading = shift & 1;
+        } else if (gotLen == 1) {
+            ptr = shift; // Register address
+        } else {
+            regs[ptr++] = shift;
+        }
+        if (gotLen < sizeof(got)) got[gotLen++] = shift;
+        drive = true; // ACK
+        ackSlot = true;
+        ours = true;
+    }
+};
+
+// Exact frame length: START, bytes with their ACKs, an optional repeated START, STOP, padding
+static uint16_t frameTicks(uint16_t bytes, bool restart) {
+    return (3 + 36 * bytes + (restart ? 4 : 0) + 4 + 31) & ~31;
+}
+
+// Frame played on the bus: SDA and SCL level per tick, and the SDA samples
+struct Bus {
+    uint32_t rx[SI_PIO_MAX_TICKS / 32];
+    bool scl[SI_PIO_MAX_TICKS];
+    bool glitch = false; // SDA changed with SCL high outside START/STOP
+
+    void play(const uint32_t* tx, uint16_t ticks, Slave& s) {
+        bool prevSda = true, prevScl = true;
+        memset(rx, 0, sizeof(rx));
+        for (uint16_t t = 0; t < ticks; t++) {
+            uint32_t dirs = (tx[t >> 4] >> ((t & 15) * 2)) & 3;
+            bool sda = !(dirs & 1) && !s.drive;
+            bool c = !(dirs & 2);
+            scl[t] = c;
+            if (sda) rx[t >> 5] |= 1UL << (t & 31);
+            if (prevScl && c && prevSda != sda) {
+                if (!sda) s.start();
+                else s.stop();
+            }
+            if (!prevScl && c) s.rise(sda);
+            if (prevScl && !c) s.fall();
+            prevSda = sda;
+            prevScl = c;
+        }
+        if (!prevSda || !prevScl) glitch = true; // Must end idle
+    }
+
+    // A sample slot sits in the middle of an SCL high phase
+    bool high(uint16_t k) const { return k > 0 && scl[k - 1] && scl[k]; }
+};
+
+static uint32_t tx[SI_PIO_MAX_TICKS / 16];
+static uint16_t ack[SI_PIO_MAX_BYTES + 2];
+
+static void testWrite() {
+    Slave s;
+    Bus bus;
+    const uint8_t head = 26;
+    const uint8_t data[] = {0xA5, 0x00, 0xFF, 0x3C};
+    uint16_t ticks = Si5351PioBus::buildWrite(tx, ack, 0x60, &head, 1, data, sizeof(data));
+    CHECK_EQ(ticks, frameTicks(1 + 1 + sizeof(data), false));
+    CHECK(ticks <= SI_PIO_TICKS(1 + 1 + sizeof(data)));
+    CHECK_EQ(ticks % 32, 0);
+    bus.play(tx, ticks, s);
+    CHECK_EQ(s.starts, 1);
+    CHECK_EQ(s.stops, 1);
+    CHECK(!bus.glitch);
+    const uint8_t want[] = {0xC0, 26, 0xA5, 0x00, 0xFF, 0x3C};
+    CHECK_EQ(s.gotLen, sizeof(want));
+    CHECK_BYTES(s.got, want, sizeof(want));
+    CHECK_BYTES(&s.regs[26], data, sizeof(data));
+    for (uint8_t i = 0; i < sizeof(want); i++) {
+        CHECK(bus.high(ack[i]));
+        CHECK(!Si5351PioBus::sample(bus.rx, ack[i])); // ACK
+    }
+
+    // Another address: the slave stays off SDA, the first ACK slot reads high
+    Slave other;
+    other.addr = 0x61;
+    bus.play(tx, ticks, other);
+    CHECK(Si5351PioBus::sample(bus.rx, ack[0]));
+}
+
+static void testRead(uint8_t headLen) {
+    Slave s;
+    Bus bus;
+    for (uint16_t r = 0; r < 256; r++) s.regs[r] = (uint8_t)(r * 7 + 1);
+    s.ptr = 40; // Where a read without a head starts
+    const uint8_t head = 177;
+    uint16_t first = 0;
+    uint8_t data[5];
+    uint16_t ticks = Si5351PioBus::buildRead(tx, ack, &first, 0x60, &head, headLen, sizeof(data));
+    uint16_t bytes = 1 + headLen + (headLen ? 1 : 0) + sizeof(data);
+    CHECK_EQ(ticks, frameTicks(bytes, headLen));
+    CHECK(ticks <= SI_PIO_TICKS(bytes));
+    CHECK_EQ(ticks % 32, 0);
+    bus.play(tx, ticks, s);
+    CHECK_EQ(s.starts, headLen ? 2 : 1); // Repeated START after the head
+    CHECK_EQ(s.stops, 1);
+    CHECK(!bus.glitch);
+    CHECK_EQ(s.masterAcks, sizeof(data) - 1);
+    CHECK_EQ(s.nacked, 1); // Last byte
+    uint8_t acks = headLen ? headLen + 2 : 1;
+    for (uint8_t i = 0; i < acks; i++) {
+        CHECK(bus.high(ack[i]));
+        CHECK(!Si5351PioBus::sample(bus.rx, ack[i]));
+    }
+    uint8_t base = headLen ? head : 40;
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        uint8_t v = 0;
+        for (uint8_t b = 0; b < 8; b++) {
+            uint16_t k = first + 36 * i + 4 * b;
+            CHECK(bus.high(k));
+            v = v << 1 | Si5351PioBus::sample(bus.rx, k);
+        }
+        data[i] = v;
+        CHECK_EQ(data[i], s.regs[(uint8_t)(base + i)]);
+    }
+}
+
+static void testLimits() {
+    uint8_t data[SI_PIO_MAX_BYTES] = {};
+    uint8_t head = 0;
+    uint16_t first;
+
+    // The longest frames fit the buffers
+    uint16_t ticks = Si5351PioBus::buildWrite(tx, ack, 0x60, &head, 1, data, SI_PIO_MAX_BYTES - 1);
+    CHECK_EQ(ticks, frameTicks(SI_PIO_MAX_BYTES + 1, false));
+    CHECK(ticks <= SI_PIO_MAX_TICKS);
+    ticks = Si5351PioBus::buildRead(tx, ack, &first, 0x60, &head, 1, SI_PIO_MAX_BYTES - 1);
+    CHECK_EQ(ticks, frameTicks(SI_PIO_MAX_BYTES + 2, true));
+    CHECK(ticks <= SI_PIO_MAX_TICKS);
+    CHECK(first + 36 * (SI_PIO_MAX_BYTES - 2) + 28 < ticks);
+
+    // Longer ones are refused, as is an empty read
+    CHECK_EQ(Si5351PioBus::buildWrite(tx, ack, 0x60, &head, 1, data, SI_PIO_MAX_BYTES), 0);
+    CHECK_EQ(Si5351PioBus::buildRead(tx, ack, &first, 0x60, &head, 1, SI_PIO_MAX_BYTES), 0);
+    CHECK_EQ(Si5351PioBus::buildRead(tx, ack, &first, 0x60, &head, 1, 0), 0);
+
+    // What the driver may send in one write
+    Si5351PioBus pio(4, 5);
+    CHECK_EQ(pio.maxWrite(), SI_PIO_MAX_BYTES);
+}
+
+int main() {
+    testWrite();
+    testRead(1);
+    testRead(0);
+    testLimits();
+    return checkResult("test_pio");
+}
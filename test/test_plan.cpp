@@ -0,0 +1,131 @@
+/*
+ * test_plan.cpp
+ *
+ * Planner fuzz harness: Si5351::plan(), planVco() and planDivider() against an
+ * exact rational reference. Every accepted plan must hold valid dividers, keep
+ * the VCO inside vcoWindow(), and land within half a PLL numerator step:
+ *
+ *   |xtal * (a + b/c) / (msi * R) - freq| <= xtal / (2 * c * msi * R)
+ *
+ * and no frequency that some R and even divider can reach may be rejected.
+ *
+ * Runs as a standalone program (random cases from a fixed seed, then edge
+ * cases; "test_plan <cases> <seed>" to change them), or as a libFuzzer target
+ * built with -DSI5351_LIBFUZZER -fsanitize=fuzzer.
+ */
+
+#include "si5351.h"
+#include "check.h"
+#include <stdlib.h>
+
+// Any R (power of two) and even MultiSynth divider that puts the VCO in the window
+static bool reachable(uint32_t xtal, uint32_t freq) {
+    uint64_t lo, hi;
+    if (!freq || !Si5351::vcoWindow(xtal, lo, hi)) return false;
+    for (uint32_t r = 1; r <= 128; r <<= 1) {
+        for (uint32_t msi = 4; msi <= 126; msi += 2) {
+            uint64_t vco = (uint64_t)freq * r * msi;
+            if (vco >= lo && vco <= hi) return true;
+        }
+    }
+    return false;
+}
+
+// Dividers valid, VCO in range and the produced frequency within the rounding bound
+static void checkPlan(uint32_t xtal, uint32_t freq, const vfo_t& v) {
+    uint64_t lo, hi;
+    CHECK(Si5351::vcoWindow(xtal, lo, hi));
+    CHECK_EQ(v.freq, freq);
+    CHECK(v.ri && v.ri <= 128 && !(v.ri & (v.ri - 1)));
+    CHECK(v.msi >= 4 && v.msi <= 126 && !(v.msi & 1));
+    CHECK(v.msna >= SI_MSN_MIN && v.msna <= SI_MSN_MAX && v.msnb < SI_PLL_C);
+    CHECK(v.msna < SI_MSN_MAX || v.msnb == 0);
+
+    uint64_t vco = (uint64_t)freq * v.ri * v.msi; // Target VCO
+    CHECK(vco >= lo && vco <= hi);
+
+    // Exact: 2 * |xtal * (a * c + b) - freq * c * msi * R| <= xtal
+    uint64_t num = (uint64_t)xtal * ((uint64_t)v.msna * SI_PLL_C + v.msnb);
+    uint64_t want = vco * SI_PLL_C;
+    uint64_t err = num > want ? num - want : want - num;
+    CHECK(2 * err <= xtal);
+    if (2 * err > xtal) fprintf(stderr, "  xtal %lu freq %lu: error %llu/%llu Hz\n", (unsigned long)xtal,
+                                (unsigned long)freq, (unsigned long long)err, (unsigned long long)(SI_PLL_C * v.msi * v.ri));
+}
+
+static void checkCase(uint32_t xtal, uint32_t freq, uint32_t target, uint8_t ri, uint8_t msi) {
+    bool solvable = reachable(xtal, freq);
+
+    vfo_t v = vfo_t();
+    bool ok = Si5351::plan(xtal, freq, v);
+    CHECK_EQ(ok, solvable);
+    if (ok != solvable) fprintf(stderr, "  plan: xtal %lu freq %lu\n", (unsigned long)xtal, (unsigned long)freq);
+    if (ok) checkPlan(xtal, freq, v);
+
+    v = vfo_t();
+    ok = Si5351::planVco(xtal, freq, target, v);
+    CHECK_EQ(ok, solvable);
+    if (ok) checkPlan(xtal, freq, v);
+
+    // planDivider accepts exactly the combinations that keep the VCO in the window
+    uint64_t lo, hi;
+    bool valid = Si5351::vcoWindow(xtal, lo, hi) && freq && msi >= 4 && msi <= 126 && !(msi & 1) && ri &&
+                 !(ri & (ri - 1));
+    uint64_t vco = (uint64_t)freq * ri * msi;
+    valid = valid && vco >= lo && vco <= hi;
+    v = vfo_t();
+    ok = Si5351::planDivider(xtal, freq, ri, msi, v);
+    CHECK_EQ(ok, valid);
+    if (ok) {
+        CHECK_EQ(v.ri, ri);
+        CHECK_EQ(v.msi, msi);
+        checkPlan(xtal, freq, v);
+    }
+}
+
+#ifdef SI5351_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    if (size < 14) return 0;
+    uint32_t w[3];
+    memcpy(w, data, sizeof(w));
+    uint32_t xtal = 4000000UL + w[0] % 61000000UL; // Past both ends of the usable crystal range
+    checkCase(xtal, w[1] % 300000000UL, w[2], data[12], data[13]);
+    if (checkFailures) abort();
+    return 0;
+}
+#else
+static uint32_t rng;
+
+static uint32_t next() { // xorshift32
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+int main(int argc, char** argv) {
+    uint32_t cases = argc > 1 ? strtoul(argv[1], nullptr, 0) : 200000;
+    rng = argc > 2 ? strtoul(argv[2], nullptr, 0) : 0x5351;
+    if (!rng) rng = 1;
+
+    for (uint32_t i = 0; i < cases && checkFailures < 20; i++) {
+        // Mostly crystals near the common 25/27 MHz parts, some anywhere in 4..65 MHz
+        uint32_t xtal = (i & 7) ? 24000000UL + next() % 4000000UL : 4000000UL + next() % 61000000UL;
+        uint32_t freq = (i & 1) ? next() % 300000000UL : next() % (1UL << (next() % 25 + 4));
+        checkCase(xtal, freq, 300000000UL + next() % 700000000UL, 1 << (next() % 9), next() % 130);
+    }
+
+    // Edges: the ends of the frequency range and around every R switch, for the usual crystals
+    static const uint32_t xtals[] = {25000000UL, 27000000UL, 26000000UL, 4444445UL, 10000000UL, 60000000UL};
+    for (uint8_t x = 0; x < sizeof(xtals) / sizeof(xtals[0]); x++) {
+        uint64_t lo, hi;
+        if (!Si5351::vcoWindow(xtals[x], lo, hi)) continue;
+        uint32_t edges[] = {(uint32_t)(hi / 4), (uint32_t)(lo / (128 * 126)), (uint32_t)(lo / 126), (uint32_t)(lo / 252),
+                            (uint32_t)(lo / 504), (uint32_t)(lo / 1008), (uint32_t)(lo / 2016), (uint32_t)(hi / 126)};
+        for (uint8_t e = 0; e < sizeof(edges) / sizeof(edges[0]); e++) {
+            for (int32_t d = -3; d <= 3; d++) checkCase(xtals[x], edges[e] + d, SI_VCO_TARGET, 1, 126);
+        }
+    }
+    return checkResult("test_plan");
+}
+#endif
@@ -0,0 +1,124 @@
+/*
+ * test_scan.cpp
+ *
+ * Scan timing against the lock status: after a hop that resets the PLL the
+ * callback waits for LOL to clear (mock status register), with the reset time
+ * only as a timeout; a numerator-only hop signals after the fixed settling.
+ * Hops that do not reach the chip are never reported as valid.
+ */
+
+#include "si5351_scan.h"
+#include "check.h"
+#include "mock_bus.h"
+
+struct Log {
+    uint16_t calls = 0;
+    uint16_t last = 0xFFFF;
+};
+
+static uint32_t onValid(void* ctx, uint16_t index, uint32_t freqHz) {
+    (void)freqHz;
+    Log* log = (Log*)ctx;
+    log->calls++;
+    log->last = index;
+    return 0;
+}
+
+// A failed bus write skips the channel; a VFO that refuses the plans stops the scan
+static void testFailures() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    vfo.begin();
+    static const uint32_t channels[] = {7000000UL, 7001000UL, 7002000UL};
+    si_scan_ch_t planned[3];
+    Si5351Scan scan(vfo, 0);
+    CHECK_EQ(scan.plan(channels, 3, planned), 3);
+    Log log;
+    scan.onValid(onValid, &log);
+    scan.setSettle(200, 1500);
+    scan.start(0);
+    scan.poll(300); // 7 MHz locked (status 0), signalled, 7.001 MHz tuned
+    CHECK_EQ(log.calls, 1);
+    bus.fail = 1; // 7.002 MHz does not reach the chip
+    scan.poll(600);
+    CHECK_EQ(log.calls, 2);
+    CHECK_EQ(scan.failed(), 1);
+    uint32_t visits = scan.visits();
+    scan.poll(601); // Skipped without a callback, back to 7 MHz
+    CHECK_EQ(log.calls, 2);
+    CHECK_EQ(scan.current(), 0);
+    CHECK_EQ(scan.visits(), visits + 1);
+    scan.poll(900);
+    CHECK_EQ(log.calls, 3);
+    CHECK_EQ(log.last, 0);
+
+#if SI5351_VFO_COUNT > 1
+    CHECK(vfo.setFractional(1, true));
+    Si5351Scan frac(vfo, 1);
+    CHECK_EQ(frac.plan(channels, 3, planned), 3);
+    Log none;
+    frac.onValid(onValid, &none);
+    frac.start(0);
+    CHECK_EQ(frac.failed(), 1);
+    CHECK(!frac.running());
+    frac.poll(5000);
+    CHECK_EQ(none.calls, 0);
+#endif
+}
+
+int main() {
+    MockBus bus;
+    Si5351 vfo(25000000UL);
+    vfo.setBus(&bus);
+    vfo.begin();
+
+    // 7 MHz, 7.001 MHz on the same divider, then 28 MHz on another one
+    static const uint32_t channels[] = {28000000UL, 7000000UL, 7001000UL};
+    si_scan_ch_t planned[3];
+    Si5351Scan scan(vfo, 0);
+    CHECK_EQ(scan.plan(channels, 3, planned), 3);
+    CHECK_EQ(scan.groups(), 2);
+    Log log;
+    scan.onValid(onValid, &log);
+    scan.setSettle(200, 1500);
+
+    // First channel is 7 MHz: begin() left another divider, so the hop resets the PLL
+    bus.status = SI_STATUS_LOL_A;
+    scan.start(0);
+    CHECK_EQ(scan.resets(), 1);
+    scan.poll(100); // Too early to look
+    scan.poll(300); // Not locked yet
+    CHECK_EQ(log.calls, 0);
+    bus.status = 0;
+    scan.poll(450); // Locked: signal at once, well before the 1500 us timeout
+    CHECK_EQ(log.calls, 1);
+    CHECK_EQ(log.last, 1);
+
+    // 7.001 MHz only changes the numerator: the fixed settling, no status read
+    bus.status = SI_STATUS_LOL_A;
+    scan.poll(600);
+    CHECK_EQ(log.calls, 1);
+    CHECK_EQ(scan.resets(), 1);
+    scan.poll(650);
+    CHECK_EQ(log.calls, 2);
+    CHECK_EQ(log.last, 2);
+
+    // 28 MHz resets the PLL, which never locks: skipped at the timeout, back to 7 MHz
+    scan.poll(1000);
+    scan.poll(2149);
+    CHECK_EQ(log.calls, 2);
+    CHECK_EQ(scan.unlocked(), 0);
+    scan.poll(2150);
+    CHECK_EQ(log.calls, 2);
+    CHECK_EQ(scan.unlocked(), 1);
+    CHECK_EQ(scan.current(), 1);
+    CHECK_EQ(scan.resets(), 3);
+
+    // PLLB status does not count for VFO0
+    bus.status = SI_STATUS_LOL_B;
+    scan.poll(2400);
+    CHECK_EQ(log.calls, 3);
+    testFailures();
+    return checkResult("test_scan");
+}
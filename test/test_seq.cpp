@@ -0,0 +1,191 @@
+/*
+ * test_seq.cpp
+ *
+ * Sequencer programs on the virtual clock: a recorder writer logs every write
+ * with simTime(), so the timing of waits, repeated blocks and ends can be
+ * checked. freq() re-emits the MultiSynth images, phase offset and PLL reset
+ * only when the divider or phase changes. Truncated programs, writes past the
+ * register map and unbalanced loops are rejected by check(), and the VM stops
+ * at a bad write instead of sending it.
+ */
+
+#include <string.h>
+#include "si5351_seq.h"
+#include "check.h"
+
+struct Rec {
+    uint16_t n = 0;
+    struct {
+        uint32_t t;
+        uint8_t reg, len, first;
+    } w[32];
+};
+
+static Si5351Seq* simSeq; // For simTime() inside the writer
+
+static void record(void* ctx, uint8_t reg, const uint8_t* data, uint8_t len) {
+    Rec* rec = (Rec*)ctx;
+    if (rec->n < 32) {
+        rec->w[rec->n].t = simSeq->simTime();
+        rec->w[rec->n].reg = reg;
+        rec->w[rec->n].len = len;
+        rec->w[rec->n].first = data[0];
+    }
+    rec->n++;
+}
+
+// OE, then a block of two events repeated twice, then a last write; waits add up with no drift
+static void testProgram() {
+    static const uint8_t ctl = 0x4F, off = 0xFF;
+    uint8_t prog[64];
+    Si5351SeqBuilder b(prog, sizeof(prog));
+    b.outputs(0xFE).wait(50)
+     .repeat(2).write(SI_CLK0_CTL, &ctl, 1).wait(100).reset(SI_PLL_RESET_A).wait(200).next()
+     .write(SI_CLK_OE, &off, 1).end();
+    CHECK(b.ok());
+    CHECK(Si5351Seq::check(prog, b.size()));
+
+    Rec rec;
+    Si5351Seq seq(record, &rec);
+    simSeq = &seq;
+    CHECK(seq.load(prog, b.size()));
+    CHECK_EQ(seq.simulate(10000), 650);
+    CHECK(!seq.running());
+    CHECK_EQ(rec.n, 6);
+    static const uint32_t t[] = {0, 50, 150, 350, 450, 650};
+    static const uint8_t reg[] = {SI_CLK_OE, SI_CLK0_CTL, SI_PLL_RESET, SI_CLK0_CTL, SI_PLL_RESET, SI_CLK_OE};
+    static const uint8_t first[] = {0xFE, 0x4F, SI_PLL_RESET_A, 0x4F, SI_PLL_RESET_A, 0xFF};
+    for (uint8_t i = 0; i < 6 && i < rec.n; i++) {
+        CHECK_EQ(rec.w[i].t, t[i]);
+        CHECK_EQ(rec.w[i].reg, reg[i]);
+        CHECK_EQ(rec.w[i].first, first[i]);
+    }
+
+    // simulate() stops at maxUs inside a forever loop
+    Si5351SeqBuilder f(prog, sizeof(prog));
+    f.repeat(0).outputs(0).wait(1000).next().end();
+    rec.n = 0;
+    seq.load(prog);
+    CHECK_EQ(seq.simulate(4500), 5000);
+    CHECK_EQ(rec.n, 5);
+    CHECK(seq.running());
+}
+
+// Same divider: PLL numerator only; a new divider or phase: MultiSynths, PHOFF and the reset again
+static void testFreq() {
+    uint8_t prog[256];
+    Si5351SeqBuilder b(prog, sizeof(prog));
+    b.freq(0, 7000000UL).wait(1000)
+     .freq(0, 7001000UL).wait(1000)
+     .freq(0, 14000000UL).wait(1000)
+     .freq(0, 14000000UL, PH090).wait(1000)
+     .freq(1, 10000000UL).end();
+    CHECK(b.ok());
+
+    Rec rec;
+    Si5351Seq seq(record, &rec);
+    simSeq = &seq;
+    CHECK(seq.load(prog, b.size()));
+    seq.simulate(10000);
+    static const uint8_t reg[] = {
+        SI_SYNTH_PLLA, SI_SYNTH_MS0, SI_CLK0_PHOFF, SI_PLL_RESET, // 7 MHz
+        SI_SYNTH_PLLA,                                            // 7.001 MHz, same divider
+        SI_SYNTH_PLLA, SI_SYNTH_MS0, SI_CLK0_PHOFF, SI_PLL_RESET, // 14 MHz
+        SI_SYNTH_PLLA, SI_SYNTH_MS0, SI_CLK0_PHOFF, SI_PLL_RESET, // 14 MHz at 90°
+        SI_SYNTH_PLLB, SI_SYNTH_MS2, SI_PLL_RESET,                // VFO1 has its own history
+    };
+    static const uint8_t len[] = {8, 16, 2, 1, 8, 8, 16, 2, 1, 8, 16, 2, 1, 8, 8, 1};
+    static const uint32_t t[] = {0, 0, 0, 0, 1000, 2000, 2000, 2000, 2000, 3000, 3000, 3000, 3000, 4000, 4000, 4000};
+    CHECK_EQ(rec.n, sizeof(reg));
+    for (uint8_t i = 0; i < sizeof(reg) && i < rec.n; i++) {
+        CHECK_EQ(rec.w[i].reg, reg[i]);
+        CHECK_EQ(rec.w[i].len, len[i]);
+        CHECK_EQ(rec.w[i].t, t[i]);
+    }
+    CHECK_EQ(rec.w[3].first, SI_PLL_RESET_A);
+    CHECK_EQ(rec.w[15].first, SI_PLL_RESET_B);
+
+    // 90° puts the divider into CLK1's phase offset, 0° clears it
+    uint8_t phoff[2];
+    const uint8_t* p = prog;
+    uint8_t seen = 0;
+    while (*p != SI_SEQ_END) {
+        if (p[0] == SI_SEQ_WRITE && p[1] == SI_CLK0_PHOFF) {
+            memcpy(phoff, p + 3, 2);
+            seen++;
+            if (seen == 2) CHECK_EQ(phoff[1], 0);
+        }
+        p += p[0] == SI_SEQ_WAIT ? 5 : p[0] == SI_SEQ_WRITE ? 3 + p[2] : p[0] == SI_SEQ_NEXT ? 1 : 2;
+    }
+    CHECK_EQ(seen, 3);
+    CHECK(phoff[1] != 0);
+
+    // The builder refuses what the planner refuses
+    Si5351SeqBuilder bad(prog, sizeof(prog));
+    bad.freq(0, 1000UL);
+    CHECK(!bad.ok());
+    Si5351SeqBuilder small(prog, 20);
+    small.freq(0, 7000000UL);
+    CHECK(!small.ok());
+}
+
+static void testReject() {
+    uint8_t prog[64];
+    Si5351SeqBuilder b(prog, sizeof(prog));
+    static const uint8_t data[4] = {1, 2, 3, 4};
+    b.wait(10).write(SI_SYNTH_PLLA, data, 4).repeat(1).outputs(0).next().end();
+    uint16_t n = b.size();
+    CHECK(Si5351Seq::check(prog, n));
+
+    // Every truncation is rejected: cut operands or no SI_SEQ_END
+    bool allRejected = true;
+    for (uint16_t cut = 0; cut < n; cut++) {
+        if (Si5351Seq::check(prog, cut)) allRejected = false;
+    }
+    CHECK(allRejected);
+    CHECK(!Si5351Seq::check(nullptr, 8));
+
+    Rec rec;
+    Si5351Seq seq(record, &rec);
+    simSeq = &seq;
+    CHECK(!seq.load(prog, n - 1));
+    CHECK(!seq.running());
+
+    // Writes past the register map, or empty
+    static const uint8_t past[] = {SI_SEQ_WRITE, 186, 3, 1, 2, 3, SI_SEQ_END};
+    static const uint8_t empty[] = {SI_SEQ_WRITE, 16, 0, SI_SEQ_END};
+    static const uint8_t last[] = {SI_SEQ_WRITE, 185, 3, 1, 2, 3, SI_SEQ_END};
+    CHECK(!Si5351Seq::check(past, sizeof(past)));
+    CHECK(!Si5351Seq::check(empty, sizeof(empty)));
+    CHECK(Si5351Seq::check(last, sizeof(last)));
+    Si5351SeqBuilder w(prog, sizeof(prog));
+    w.write(186, data, 3);
+    CHECK(!w.ok());
+    CHECK_EQ(w.size(), 0);
+
+    // The VM stops at a bad write without sending it, even if loaded unchecked
+    seq.load(past);
+    seq.simulate(1000);
+    CHECK_EQ(rec.n, 0);
+    CHECK(!seq.running());
+
+    // Loops: a stray SI_SEQ_NEXT, nesting deeper than SI_SEQ_DEPTH, an unknown opcode
+    static const uint8_t stray[] = {SI_SEQ_NEXT, SI_SEQ_END};
+    static const uint8_t deep[] = {SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1,
+                                   SI_SEQ_REPEAT, 1, SI_SEQ_NEXT, SI_SEQ_NEXT, SI_SEQ_NEXT, SI_SEQ_NEXT,
+                                   SI_SEQ_NEXT, SI_SEQ_END};
+    static const uint8_t nested[] = {SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1, SI_SEQ_REPEAT, 1,
+                                     SI_SEQ_NEXT, SI_SEQ_NEXT, SI_SEQ_NEXT, SI_SEQ_NEXT, SI_SEQ_END};
+    static const uint8_t unknown[] = {0x7F, SI_SEQ_END};
+    CHECK(!Si5351Seq::check(stray, sizeof(stray)));
+    CHECK(!Si5351Seq::check(deep, sizeof(deep)));
+    CHECK(Si5351Seq::check(nested, sizeof(nested))); // SI_SEQ_DEPTH levels
+    CHECK(!Si5351Seq::check(unknown, sizeof(unknown)));
+}
+
+int main() {
+    testProgram();
+    testFreq();
+    testReject();
+    return checkResult("test_seq");
+}
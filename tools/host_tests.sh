@@ -0,0 +1,33 @@
+#!/bin/sh
+#
+# host_tests.sh
+#
+# Build and run the host tests in test/ (test_*.cpp) against the driver sources, with the
+# Arduino stand-ins from test/host. Exits non-zero if any test fails or does not build.
+#
+# Usage: tools/host_tests.sh [test_encode ...]
+#
+# CXX defaults to g++; extra flags (e.g. -fsanitize=address,undefined) go in HOST_CXXFLAGS.
+#
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=gnu++17 -O1 -g -Wall -Wextra ${HOST_CXXFLAGS}"
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+if [ $# -eq 0 ]; then
+    set -- $(cd "$ROOT/test" && ls test_*.cpp | sed 's/\.cpp$//')
+fi
+
+failed=0
+for name in "$@"; do
+    if ! $CXX $CXXFLAGS -I"$ROOT/test/host" -I"$ROOT/si5351" -o "$TMP/$name" \
+            "$ROOT/test/$name.cpp" "$ROOT/test/host/host.cpp" "$ROOT"/si5351/*.cpp; then
+        echo "$name: build failed"
+        failed=1
+        continue
+    fi
+    "$TMP/$name" || failed=1
+done
+exit $failed
@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# size_report.sh
+#
+# Flash/RAM footprint of the Si5351 driver for each build profile.
+#
+# Usage: SI5351_CXXFLAGS="-I<core> -I<variant> -I<Wire>" tools/size_report.sh
+#
+# CXX and SIZE default to the ARM toolchain used by PlatformIO for RP2040, the include
+# paths of the Arduino core and the Wire library must be passed in SI5351_CXXFLAGS.
+#
+
+CXX=${CXX:-arm-none-eabi-g++}
+SIZE=${SIZE:-arm-none-eabi-size}
+CXXFLAGS="-Os -std=gnu++17 -ffunction-sections -fdata-sections ${SI5351_CXXFLAGS}"
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# One global driver instance, so the per-object RAM shows up in .bss
+printf '#include "si5351.h"\nSi5351 vfo;\n' > "$TMP/instance.cpp"
+
+# Code placed in .time_critical by SI5351_RAM_HOTPATH is copied to SRAM at boot
+hot() {
+    $SIZE -A "$@" | awk '/^\.time_critical/ { s += $2 } END { print s + 0 }'
+}
+
+# Sum one column (1 = text, 2 = data, 3 = bss) of the size output for the given objects
+col() {
+    n=$1; shift
+    $SIZE "$@" | awk -v n="$n" 'NR > 1 { s += $n } END { print s }'
+}
+
+printf '%-22s %10s %10s\n' "profile" "flash" "ram"
+while read -r name flags; do
+    [ -z "$name" ] && continue
+    $CXX $CXXFLAGS $flags -I"$ROOT/si5351" -c "$ROOT/si5351/si5351.cpp" -o "$TMP/si5351.o" || exit 1
+    $CXX $CXXFLAGS $flags -I"$ROOT/si5351" -c "$TMP/instance.cpp" -o "$TMP/instance.o" || exit 1
+    text=$(col 1 "$TMP/si5351.o" "$TMP/instance.o")
+    data=$(col 2 "$TMP/si5351.o" "$TMP/instance.o")
+    bss=$(col 3 "$TMP/si5351.o" "$TMP/instance.o")
+    ram=$((data + bss + $(hot "$TMP/si5351.o")))
+    printf '%-22s %10d %10d\n' "$name" $((text + data)) $ram
+done <<PROFILES
+default
+minimal               -DSI5351_MINIMAL
+quadrature-only       -DSI5351_VFO_COUNT=1
+minimal+quadrature    -DSI5351_MINIMAL -DSI5351_VFO_COUNT=1
+ram-hotpath           -DSI5351_RAM_HOTPATH -DARDUINO_ARCH_RP2040
+PROFILES